@@ -0,0 +1,136 @@
+/*
+The MIT License (MIT)
+
+Copyright (c) 2017 Lancaster University.
+
+Permission is hereby granted, free of charge, to any person obtaining a
+copy of this software and associated documentation files (the "Software"),
+to deal in the Software without restriction, including without limitation
+the rights to use, copy, modify, merge, publish, distribute, sublicense,
+and/or sell copies of the Software, and to permit persons to whom the
+Software is furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+DEALINGS IN THE SOFTWARE.
+*/
+
+#ifndef ATMEGA_ADC_STREAM_H
+#define ATMEGA_ADC_STREAM_H
+
+#include "CodalConfig.h"
+#include "CodalComponent.h"
+#include "ATMegaPin.h"
+
+// Size of each of the two sample blocks, in bytes.
+#ifndef ATMEGA_ADC_STREAM_BLOCK_SIZE
+#define ATMEGA_ADC_STREAM_BLOCK_SIZE        64
+#endif
+
+// Each block is sent preceded by two sync bytes and an 8 bit block sequence number.
+#define ATMEGA_ADC_STREAM_SYNC0             0xA5
+#define ATMEGA_ADC_STREAM_SYNC1             0x5A
+#define ATMEGA_ADC_STREAM_HEADER_SIZE       3
+
+#define ATMEGA_ADC_STREAM_NONE              0xFF
+
+// Status flags
+#define ATMEGA_ADC_STREAM_STATUS_RUNNING    0x01
+#define ATMEGA_ADC_STREAM_STATUS_10BIT      0x02
+
+namespace codal
+{
+    /**
+      * Class definition for a continuous ADC to serial streaming pipeline.
+      *
+      * Timer0 triggers each conversion in hardware at the requested rate. The ADC interrupt
+      * stores each sample into one of two blocks, and as each block fills it is handed to the
+      * USART data register empty interrupt to transmit, whilst sampling continues into the other.
+      * Neither side involves a fiber, so the sustained sample rate is limited only by the baud rate
+      * (baud / 10 bytes per second, less the block header).
+      *
+      * If a block fills before the previous one has been sent, it is dropped and counted. Block
+      * sequence numbers advance for dropped blocks too, so gaps are also visible to the receiver.
+      *
+      * Samples are sent as single bytes (the top 8 bits), or as little endian 10 bit values.
+      * Whilst streaming, Timer0 and the USART transmitter are owned by this class, so
+      * ATMegaSerial must not be used.
+      */
+    class ATMegaADCStream : public CodalComponent
+    {
+        private:
+
+            ATMegaPin           &pin;
+
+            uint8_t             buffer[2][ATMEGA_ADC_STREAM_BLOCK_SIZE];
+            uint8_t             sequence[2];
+            uint8_t             nextSequence;
+
+            volatile uint8_t    fillBlock;
+            volatile uint8_t    fillPosition;
+            volatile uint8_t    txBlock;
+            volatile uint8_t    txPosition;
+
+            volatile uint16_t   sent;
+            volatile uint16_t   dropped;
+
+        public:
+
+            /**
+             * Constructor.
+             *
+             * @param pin The analog pin to sample.
+             */
+            ATMegaADCStream(ATMegaPin &pin);
+
+            /**
+             * Starts sampling and streaming.
+             *
+             * @param sampleRate The number of samples per second.
+             * @param tenBit true to send full 10 bit samples as two bytes, false to send the top 8 bits.
+             *
+             * @return DEVICE_OK on success, DEVICE_NOT_SUPPORTED if the pin is not an ADC input, or
+             *         DEVICE_INVALID_PARAMETER if the sample rate cannot be generated by Timer0
+             *         or exceeds the conversion rate of the ADC.
+             */
+            int start(uint32_t sampleRate, bool tenBit = false);
+
+            /**
+             * Stops sampling. A block already being transmitted is allowed to complete, whilst a
+             * partially filled block is discarded.
+             *
+             * @return DEVICE_OK on success.
+             */
+            int stop();
+
+            /**
+             * Determines the number of blocks transmitted since start().
+             */
+            uint16_t getSentBlocks();
+
+            /**
+             * Determines the number of blocks dropped since start(), because the transmitter had not
+             * finished sending the previous block.
+             */
+            uint16_t getDroppedBlocks();
+
+            /**
+             * Stores the latest sample. Called from the ADC interrupt.
+             */
+            void sampleIrq();
+
+            /**
+             * Sends the next byte of the current block. Called from the USART data register empty interrupt.
+             */
+            void transmitIrq();
+    };
+}
+
+#endif
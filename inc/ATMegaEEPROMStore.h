@@ -0,0 +1,161 @@
+/*
+The MIT License (MIT)
+
+Copyright (c) 2017 Lancaster University.
+
+Permission is hereby granted, free of charge, to any person obtaining a
+copy of this software and associated documentation files (the "Software"),
+to deal in the Software without restriction, including without limitation
+the rights to use, copy, modify, merge, publish, distribute, sublicense,
+and/or sell copies of the Software, and to permit persons to whom the
+Software is furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+DEALINGS IN THE SOFTWARE.
+*/
+
+#ifndef ATMEGA_EEPROM_STORE_H
+#define ATMEGA_EEPROM_STORE_H
+
+#include "CodalConfig.h"
+#include "CodalComponent.h"
+
+// Size of each record slot in EEPROM. The EEPROM size must be a multiple of this.
+#ifndef ATMEGA_EEPROM_STORE_SLOT_SIZE
+#define ATMEGA_EEPROM_STORE_SLOT_SIZE       16
+#endif
+
+// Number of distinct keys (0 .. n-1) that can be stored.
+#ifndef ATMEGA_EEPROM_STORE_MAX_KEYS
+#define ATMEGA_EEPROM_STORE_MAX_KEYS        16
+#endif
+
+// Number of writes that can be queued in RAM awaiting the EEPROM.
+#ifndef ATMEGA_EEPROM_STORE_QUEUE_SIZE
+#define ATMEGA_EEPROM_STORE_QUEUE_SIZE      4
+#endif
+
+// Slot layout: key, length, sequence number (2 bytes), value, CRC.
+#define ATMEGA_EEPROM_STORE_HEADER_SIZE     4
+#define ATMEGA_EEPROM_STORE_VALUE_SIZE      (ATMEGA_EEPROM_STORE_SLOT_SIZE - ATMEGA_EEPROM_STORE_HEADER_SIZE - 1)
+#define ATMEGA_EEPROM_STORE_SLOTS           ((E2END + 1) / ATMEGA_EEPROM_STORE_SLOT_SIZE)
+
+#define ATMEGA_EEPROM_STORE_NONE            0xFF
+
+// Event raised once every queued write has reached the EEPROM.
+#define ATMEGA_EEPROM_STORE_EVT_SYNCED      1
+
+namespace codal
+{
+    /**
+      * A value waiting to be written to EEPROM.
+      */
+    struct EEPROMStoreEntry
+    {
+        uint8_t     key;
+        uint8_t     len;
+        uint8_t     value[ATMEGA_EEPROM_STORE_VALUE_SIZE];
+    };
+
+    /**
+      * Class definition for a non-volatile key/value store in the on chip EEPROM.
+      *
+      * The EEPROM is divided into fixed size slots, each holding one versioned record. Updates are
+      * written to the next free slot round the EEPROM, so wear is spread across every slot that
+      * does not hold a current value. A RAM index maps each key onto its current slot, and is
+      * rebuilt from the sequence numbers in the records at startup. A slot's key byte is erased before
+      * the rest of the record is written and programmed only after its CRC, and a current record is
+      * never overwritten, so a write torn by a reset leaves the previous value in place.
+      *
+      * put() only queues the value in RAM, coalescing repeated writes to the same key. Bytes are
+      * programmed one at a time from the EE_READY interrupt, skipping any that already hold the
+      * right value, and using erase-only or write-only cycles where they suffice.
+      */
+    class ATMegaEEPROMStore : public CodalComponent
+    {
+        private:
+
+            uint8_t             index[ATMEGA_EEPROM_STORE_MAX_KEYS];
+            uint8_t             head;
+            uint16_t            sequence;
+
+            EEPROMStoreEntry    queue[ATMEGA_EEPROM_STORE_QUEUE_SIZE];
+
+            EEPROMStoreEntry    *current;
+            uint8_t             slot;
+            uint8_t             offset;
+            uint8_t             crc;
+
+            uint8_t imageByte(uint8_t offset);
+            int nextEntry();
+
+        public:
+
+            /**
+             * Constructor.
+             * Scans the EEPROM to rebuild the index of current records.
+             *
+             * @param id The unique EventModel id of this component.
+             */
+            ATMegaEEPROMStore(uint16_t id);
+
+            /**
+             * Queues a value to be written to the given key.
+             *
+             * Returns as soon as the value is queued. If the key already has a write queued, that
+             * write is updated in place. Values identical to those already stored are not written.
+             *
+             * @param key The key to write, in the range 0 .. ATMEGA_EEPROM_STORE_MAX_KEYS - 1.
+             * @param data The value to store.
+             * @param len The length of the value, at most ATMEGA_EEPROM_STORE_VALUE_SIZE bytes.
+             *
+             * @return DEVICE_OK on success, DEVICE_INVALID_PARAMETER if the key or length are out of range,
+             *         or DEVICE_NO_RESOURCES if the write queue is full.
+             */
+            int put(uint8_t key, const void *data, uint8_t len);
+
+            /**
+             * Reads the value of the given key, including any write still queued.
+             *
+             * @param key The key to read.
+             * @param data Where to store the value.
+             * @param len The size of the buffer at data.
+             *
+             * @return the length of the value, DEVICE_NO_DATA if the key has no value,
+             *         or DEVICE_INVALID_PARAMETER if the key is out of range.
+             */
+            int get(uint8_t key, void *data, uint8_t len);
+
+            /**
+             * Removes the value of the given key.
+             *
+             * @return DEVICE_OK on success, or as put().
+             */
+            int remove(uint8_t key);
+
+            /**
+             * Determines if any writes are waiting to reach the EEPROM.
+             */
+            int isBusy();
+
+            /**
+             * Blocks the calling fiber until every queued write has reached the EEPROM.
+             */
+            void sync();
+
+            /**
+             * Programs the next byte of the current record. Called from the EE_READY interrupt.
+             */
+            void irq();
+    };
+}
+
+#endif
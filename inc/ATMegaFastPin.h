@@ -0,0 +1,146 @@
+/*
+The MIT License (MIT)
+
+Copyright (c) 2017 Lancaster University.
+
+Permission is hereby granted, free of charge, to any person obtaining a
+copy of this software and associated documentation files (the "Software"),
+to deal in the Software without restriction, including without limitation
+the rights to use, copy, modify, merge, publish, distribute, sublicense,
+and/or sell copies of the Software, and to permit persons to whom the
+Software is furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+DEALINGS IN THE SOFTWARE.
+*/
+
+#ifndef ATMEGA_FAST_PIN_H
+#define ATMEGA_FAST_PIN_H
+
+#include "CodalConfig.h"
+#include "ATMegaPin.h"
+#include <avr/io.h>
+
+// Data memory addresses of the PINx, DDRx and PORTx registers for a given port index.
+// These registers are laid out in triplets from PINB onwards (PINB, DDRB, PORTB, PINC, ...).
+#define ATMEGA_FAST_PIN_REG(port, offset)   (*(volatile uint8_t *)(0x23 + (3 * (port)) + (offset)))
+
+namespace codal
+{
+    /**
+      * Class definition for a compile time bound GPIO pin.
+      *
+      * Every register address and bit mask is a constant expression, so with optimisation enabled
+      * set(), clear() and toggle() each compile to a single SBI/CBI instruction, and read() to an
+      * SBIS/SBIC skip when used as a condition. There is no vtable and no instance state.
+      *
+      * A FastPin may address the same physical pin as an ATMegaPin. The ATMegaPin remains
+      * responsible for pull configuration and mode changes through the Pin API, whilst the
+      * FastPin is used for hot paths such as bit-banged protocols.
+      *
+      * @code
+      * FastPin<13> clock;
+      * clock.output();
+      * clock.toggle();
+      * @endcode
+      */
+    template <PinNumber N>
+    class FastPin
+    {
+        public:
+
+            static const uint8_t port = ATMEGA_PIN_PORT(N);
+            static const uint8_t mask = ATMEGA_PIN_MASK(N);
+
+            /**
+             * Configures this pin as a digital output.
+             */
+            static inline void output()
+            {
+                ATMEGA_FAST_PIN_REG(port, 1) |= mask;
+            }
+
+            /**
+             * Configures this pin as a digital input. Any pull up configured remains in place.
+             */
+            static inline void input()
+            {
+                ATMEGA_FAST_PIN_REG(port, 1) &= ~mask;
+            }
+
+            /**
+             * Drives the pin HI (or enables the pull up if configured as an input).
+             */
+            static inline void set()
+            {
+                ATMEGA_FAST_PIN_REG(port, 2) |= mask;
+            }
+
+            /**
+             * Drives the pin LO (or disables the pull up if configured as an input).
+             */
+            static inline void clear()
+            {
+                ATMEGA_FAST_PIN_REG(port, 2) &= ~mask;
+            }
+
+            /**
+             * Inverts the output. Writing a one to PINx toggles the corresponding PORTx bit in hardware.
+             */
+            static inline void toggle()
+            {
+                ATMEGA_FAST_PIN_REG(port, 0) |= mask;
+            }
+
+            /**
+             * Samples the pin.
+             *
+             * @return non-zero if the pin is HI, zero if it is LO.
+             */
+            static inline uint8_t read()
+            {
+                return ATMEGA_FAST_PIN_REG(port, 0) & mask;
+            }
+
+            /**
+             * Sets the pin to the given value, without changing its mode.
+             *
+             * @param value 0 (LO) or 1 (HI)
+             */
+            static inline void setDigitalValue(int value)
+            {
+                if (value)
+                    set();
+                else
+                    clear();
+            }
+
+            /**
+             * Samples the pin, without changing its mode.
+             *
+             * @return 1 if the pin is HI, 0 if the pin is LO.
+             */
+            static inline int getDigitalValue()
+            {
+                return read() ? 1 : 0;
+            }
+
+            /**
+             * Determines if the given ATMegaPin addresses the same physical pin as this FastPin.
+             */
+            static inline bool is(const ATMegaPin &pin)
+            {
+                return pin.name == N;
+            }
+    };
+}
+
+#endif
@@ -0,0 +1,144 @@
+/*
+The MIT License (MIT)
+
+Copyright (c) 2017 Lancaster University.
+
+Permission is hereby granted, free of charge, to any person obtaining a
+copy of this software and associated documentation files (the "Software"),
+to deal in the Software without restriction, including without limitation
+the rights to use, copy, modify, merge, publish, distribute, sublicense,
+and/or sell copies of the Software, and to permit persons to whom the
+Software is furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+DEALINGS IN THE SOFTWARE.
+*/
+
+#ifndef ATMEGA_I2C_SLAVE_H
+#define ATMEGA_I2C_SLAVE_H
+
+#include "CodalConfig.h"
+#include "CodalComponent.h"
+#include "ATMegaPin.h"
+
+// Per-register flags.
+#define ATMEGA_I2C_SLAVE_READ_ONLY          0x01        // Writes from the bus master are ignored.
+#define ATMEGA_I2C_SLAVE_NOTIFY             0x02        // Writes from the bus master invoke the write callback.
+
+// Event raised when the bus master ends a write to at least one register. The TWI reports a STOP and a
+// repeated START with the same status, so this is also raised at a repeated START that follows such a
+// write (e.g. write then read back), and again at the end of any further write in the same transaction.
+// Setting the register address alone never raises it.
+#define ATMEGA_I2C_SLAVE_EVT_WRITE          1
+
+// The TWI is fixed to SDA = PC4 and SCL = PC5.
+#define ATMEGA_I2C_SLAVE_SDA                12
+#define ATMEGA_I2C_SLAVE_SCL                13
+
+// Status flags
+#define ATMEGA_I2C_SLAVE_STATUS_ENABLED     0x01
+#define ATMEGA_I2C_SLAVE_STATUS_POINTER     0x02        // The next byte written is the register address.
+#define ATMEGA_I2C_SLAVE_STATUS_WRITTEN     0x04        // A register has been written in this transaction.
+#define ATMEGA_I2C_SLAVE_STATUS_PINS        0x08        // The pins given are the TWI pins.
+
+namespace codal
+{
+    /**
+      * Invoked from the TWI interrupt when a register flagged ATMEGA_I2C_SLAVE_NOTIFY is written.
+      *
+      * @param reg The register address.
+      * @param value The value written, which has already been stored in the register map.
+      */
+    typedef void (*I2CSlaveWriteCallback)(uint8_t reg, uint8_t value);
+
+    /**
+      * Class definition for an I2C slave that emulates a bank of registers.
+      *
+      * The bus master writes a register address followed by any number of data bytes, or sets the
+      * address and then issues a repeated START to read. The address auto-increments after each
+      * byte. Every transfer is serviced in the TWI interrupt directly from the register map,
+      * so the clock is held only for the few cycles the interrupt takes to respond.
+      *
+      * Reads beyond the end of the map return 0xFF, and writes beyond it are ignored.
+      *
+      * The register map remains owned by the application, which may update it at any time.
+      * Values wider than a byte should be updated with interrupts disabled so they are never
+      * read half written.
+      */
+    class ATMegaI2CSlave : public CodalComponent
+    {
+        private:
+
+            uint8_t                 *registers;
+            const uint8_t           *flags;
+            uint8_t                 length;
+            volatile uint8_t        pointer;
+
+            I2CSlaveWriteCallback   callback;
+
+        public:
+
+            /**
+             * Constructor.
+             * Releases the given pins to the TWI, which drives them directly once enabled.
+             *
+             * @param sda The pin to use for SDA, which must be PC4.
+             * @param scl The pin to use for SCL, which must be PC5.
+             * @param id The unique EventModel id of this component.
+             */
+            ATMegaI2CSlave(ATMegaPin &sda, ATMegaPin &scl, uint16_t id);
+
+            /**
+             * Defines the register map exposed to the bus master.
+             *
+             * @param registers The register values.
+             * @param length The number of registers, at most 255.
+             * @param flags Optional array in program memory holding ATMEGA_I2C_SLAVE_READ_ONLY /
+             *              ATMEGA_I2C_SLAVE_NOTIFY flags for each register, or NULL for all writable.
+             *
+             * @return DEVICE_OK on success.
+             */
+            int setRegisters(uint8_t *registers, uint8_t length, const uint8_t *flags = NULL);
+
+            /**
+             * Sets the function invoked when a register flagged ATMEGA_I2C_SLAVE_NOTIFY is written.
+             *
+             * The callback runs in interrupt context, and so must be brief.
+             *
+             * @param callback The function to call, or NULL.
+             */
+            void setWriteCallback(I2CSlaveWriteCallback callback);
+
+            /**
+             * Starts responding to the given 7 bit address.
+             *
+             * @param address The slave address.
+             *
+             * @return DEVICE_OK on success, DEVICE_INVALID_PARAMETER if the address is out of range, or
+             *         DEVICE_NOT_SUPPORTED if the pins given to the constructor are not the TWI pins.
+             */
+            int enable(uint8_t address);
+
+            /**
+             * Stops responding to the bus.
+             *
+             * @return DEVICE_OK on success.
+             */
+            int disable();
+
+            /**
+             * Services the TWI. Called from the TWI interrupt.
+             */
+            void irq();
+    };
+}
+
+#endif
@@ -0,0 +1,131 @@
+/*
+The MIT License (MIT)
+
+Copyright (c) 2017 Lancaster University.
+
+Permission is hereby granted, free of charge, to any person obtaining a
+copy of this software and associated documentation files (the "Software"),
+to deal in the Software without restriction, including without limitation
+the rights to use, copy, modify, merge, publish, distribute, sublicense,
+and/or sell copies of the Software, and to permit persons to whom the
+Software is furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+DEALINGS IN THE SOFTWARE.
+*/
+
+#ifndef ATMEGA_INPUT_SCANNER_H
+#define ATMEGA_INPUT_SCANNER_H
+
+#include "CodalConfig.h"
+#include "CodalComponent.h"
+#include "ATMegaPin.h"
+
+// Maximum number of keys (direct inputs plus matrix positions) a scanner can track.
+#define ATMEGA_INPUT_SCANNER_MAX_KEYS       32
+
+// Maximum number of rows or columns in a key matrix.
+#define ATMEGA_INPUT_SCANNER_MAX_LINES      8
+
+// Time allowed for the columns to settle after a row is driven, in microseconds.
+#ifndef ATMEGA_INPUT_SCANNER_SETTLE_US
+#define ATMEGA_INPUT_SCANNER_SETTLE_US      2
+#endif
+
+namespace codal
+{
+    /**
+      * Class definition for a debounced scanner of buttons and key matrices.
+      *
+      * All inputs are sampled together once per system tick, reading each of PINB/C/D once
+      * (and once per row for a matrix). Samples are debounced in parallel for every key using a
+      * two bit vertical counter, so a key must read the same for four consecutive ticks before
+      * it changes state.
+      *
+      * Each key raises DEVICE_BUTTON_EVT_DOWN and DEVICE_BUTTON_EVT_UP events like a Button,
+      * from an id of the scanner's id plus the key index.
+      */
+    class ATMegaInputScanner : public CodalComponent
+    {
+        private:
+
+            uint8_t     keys;
+            uint8_t     inputs[ATMEGA_INPUT_SCANNER_MAX_KEYS];
+            uint32_t    activeLow;
+
+            uint8_t     matrixBase;
+            uint8_t     rowCount;
+            uint8_t     colCount;
+            uint8_t     rows[ATMEGA_INPUT_SCANNER_MAX_LINES];
+            uint8_t     cols[ATMEGA_INPUT_SCANNER_MAX_LINES];
+
+            uint32_t    state;
+            uint32_t    cnt0;
+            uint32_t    cnt1;
+
+            uint32_t sample();
+
+        public:
+
+            /**
+             * Constructor.
+             * Create a scanner with no inputs.
+             *
+             * @param id The event id of the first key. Key n raises events from id + n.
+             */
+            ATMegaInputScanner(uint16_t id);
+
+            /**
+             * Adds a single pin as a key, configured as a digital input.
+             *
+             * @param pin The pin to scan.
+             * @param activeLow true if the key pulls the pin LO when pressed. The internal pull up is enabled.
+             *
+             * @return the index of the new key, or DEVICE_NO_RESOURCES if no keys remain.
+             */
+            int addInput(ATMegaPin &pin, bool activeLow = true);
+
+            /**
+             * Adds a key matrix. Rows are driven LO one at a time, and columns read with their pull ups enabled.
+             * Key (r, c) is assigned the index returned plus (r * colCount) + c.
+             *
+             * @param rowPins The row pins.
+             * @param rowCount The number of rows.
+             * @param colPins The column pins.
+             * @param colCount The number of columns.
+             *
+             * @return the index of the first key in the matrix, DEVICE_INVALID_PARAMETER if a matrix has already
+             *         been added or has too many lines, or DEVICE_NO_RESOURCES if not enough keys remain.
+             */
+            int addMatrix(ATMegaPin **rowPins, int rowCount, ATMegaPin **colPins, int colCount);
+
+            /**
+             * Determines if the given key is currently pressed, once debounced.
+             *
+             * @param key The key index.
+             *
+             * @return 1 if pressed, 0 if released, or DEVICE_INVALID_PARAMETER if the key does not exist.
+             */
+            int isPressed(int key);
+
+            /**
+             * Obtains the debounced state of every key, with bit n set if key n is pressed.
+             */
+            uint32_t getState();
+
+            /**
+             * Samples and debounces every key, raising events for those that have changed state.
+             */
+            virtual void periodicCallback();
+    };
+}
+
+#endif
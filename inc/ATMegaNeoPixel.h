@@ -0,0 +1,120 @@
+/*
+The MIT License (MIT)
+
+Copyright (c) 2017 Lancaster University.
+
+Permission is hereby granted, free of charge, to any person obtaining a
+copy of this software and associated documentation files (the "Software"),
+to deal in the Software without restriction, including without limitation
+the rights to use, copy, modify, merge, publish, distribute, sublicense,
+and/or sell copies of the Software, and to permit persons to whom the
+Software is furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+DEALINGS IN THE SOFTWARE.
+*/
+
+#ifndef ATMEGA_NEOPIXEL_H
+#define ATMEGA_NEOPIXEL_H
+
+#include "CodalConfig.h"
+#include "ATMegaPin.h"
+
+// Number of bytes sent per pixel (GRB).
+#define ATMEGA_NEOPIXEL_BYTES_PER_PIXEL     3
+
+// Longest time the line may idle LO between pixels whilst interrupts are serviced, before the
+// strip could mistake it for a reset and latch a partial frame.
+#ifndef ATMEGA_NEOPIXEL_MAX_GAP_US
+#define ATMEGA_NEOPIXEL_MAX_GAP_US          40
+#endif
+
+// Time the line is held LO after a frame, and before a restarted one, so the strip latches.
+// WS2812B parts from 2017 onwards need 280us; the original WS2812 needs 50us.
+#ifndef ATMEGA_NEOPIXEL_LATCH_US
+#define ATMEGA_NEOPIXEL_LATCH_US            300
+#endif
+
+// Number of times a frame is restarted after an interrupt overran the gap between pixels.
+// The final attempt is sent with interrupts disabled for the whole frame.
+#ifndef ATMEGA_NEOPIXEL_RETRIES
+#define ATMEGA_NEOPIXEL_RETRIES             2
+#endif
+
+namespace codal
+{
+    /**
+      * Callback used to generate pixels on demand.
+      *
+      * @param index The index of the pixel along the strip.
+      * @param pixel The three bytes (G, R, B) to populate.
+      * @param context The context pointer given to send().
+      */
+    typedef void (*NeoPixelGenerator)(int index, uint8_t *pixel, void *context);
+
+    /**
+      * Class definition for a WS2812 (NeoPixel) output driver.
+      *
+      * Bits are clocked out by a cycle counted assembly loop, tuned at compile time for an
+      * F_CPU of 8, 12, 16 or 20MHz. On any other clock the driver builds, but send() returns
+      * DEVICE_NOT_SUPPORTED. Interrupts are only disabled whilst each pixel is sent
+      * (30us), and are serviced in the gaps between pixels.
+      */
+    class ATMegaNeoPixel
+    {
+        private:
+
+            uint8_t     port;
+            uint8_t     mask;
+
+            int sendPixels(const uint8_t *buffer, int len, NeoPixelGenerator generator, void *context);
+
+        public:
+
+            /**
+             * Constructor.
+             * Create a NeoPixel driver on the given pin, and drive the pin LO.
+             *
+             * @param pin The pin connected to the data input of the strip.
+             */
+            ATMegaNeoPixel(ATMegaPin &pin);
+
+            /**
+             * Sends a buffer of pixel data to the strip.
+             *
+             * @param buffer The pixel data, in G, R, B byte order.
+             * @param len The number of bytes to send.
+             *
+             * @return DEVICE_OK on success, DEVICE_INVALID_PARAMETER if buffer is NULL,
+             *         or DEVICE_NOT_SUPPORTED if the driver has no bit timing for F_CPU.
+             */
+            int send(const uint8_t *buffer, int len);
+
+            /**
+             * Sends pixels to the strip, generating each one just before it is sent.
+             * This allows long strips to be driven without a frame buffer.
+             *
+             * The generator runs between pixels, whilst the line is idle, so it must be short
+             * (a few microseconds) to keep clear of ATMEGA_NEOPIXEL_MAX_GAP_US.
+             *
+             * @param generator The function used to generate each pixel.
+             * @param count The number of pixels to send.
+             * @param context An optional pointer handed to the generator.
+             *
+             * @return DEVICE_OK on success, DEVICE_INVALID_PARAMETER if generator is NULL,
+             *         DEVICE_NOT_SUPPORTED if the driver has no bit timing for F_CPU, or DEVICE_BUSY if the
+             *         generator is too slow to keep within ATMEGA_NEOPIXEL_MAX_GAP_US, leaving a partial frame.
+             */
+            int send(NeoPixelGenerator generator, int count, void *context = NULL);
+    };
+}
+
+#endif
@@ -0,0 +1,135 @@
+/*
+The MIT License (MIT)
+
+Copyright (c) 2017 Lancaster University.
+
+Permission is hereby granted, free of charge, to any person obtaining a
+copy of this software and associated documentation files (the "Software"),
+to deal in the Software without restriction, including without limitation
+the rights to use, copy, modify, merge, publish, distribute, sublicense,
+and/or sell copies of the Software, and to permit persons to whom the
+Software is furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+DEALINGS IN THE SOFTWARE.
+*/
+
+#ifndef ATMEGA_PARALLEL_BUS_H
+#define ATMEGA_PARALLEL_BUS_H
+
+#include "CodalConfig.h"
+#include "ATMegaPin.h"
+
+#define ATMEGA_PARALLEL_BUS_MAX_WIDTH       16
+#define ATMEGA_PARALLEL_BUS_PORTS           3
+
+// Extra time writeBlock() holds each byte on the bus before the strobe, in nanoseconds.
+#ifndef ATMEGA_PARALLEL_BUS_SETUP_NS
+#define ATMEGA_PARALLEL_BUS_SETUP_NS        0
+#endif
+
+// Extra time writeBlock() holds the strobe active, in nanoseconds.
+#ifndef ATMEGA_PARALLEL_BUS_STROBE_NS
+#define ATMEGA_PARALLEL_BUS_STROBE_NS       0
+#endif
+
+namespace codal
+{
+    /**
+      * Class definition for a parallel bus of GPIO pins.
+      *
+      * Bit n of each value read or written corresponds to the nth pin given to the constructor.
+      * Per port masks are computed once, so each access touches every port at most once, with a
+      * single masked read-modify-write performed with interrupts disabled. Outputs on the same port
+      * therefore change together, without glitching through intermediate values.
+      *
+      * Where the bus pins on a port are in the same order as the port bits (e.g. D0-D7 on PD0-PD7),
+      * values are moved with a single shift rather than bit by bit.
+      */
+    class ATMegaParallelBus
+    {
+        private:
+
+            uint8_t     width;
+            uint8_t     direct;
+            uint8_t     pins[ATMEGA_PARALLEL_BUS_MAX_WIDTH];
+            uint8_t     mask[ATMEGA_PARALLEL_BUS_PORTS];
+            int8_t      shift[ATMEGA_PARALLEL_BUS_PORTS];
+
+            uint8_t toPort(uint16_t value, uint8_t port);
+            uint16_t fromPort(uint8_t bits, uint8_t port);
+
+        public:
+
+            /**
+             * Constructor.
+             * Create a parallel bus from the given pins.
+             *
+             * @param pins The pins forming the bus, least significant bit first.
+             * @param count The number of pins, at most ATMEGA_PARALLEL_BUS_MAX_WIDTH.
+             */
+            ATMegaParallelBus(ATMegaPin **pins, int count);
+
+            /**
+             * Configures every pin on the bus as a digital output.
+             *
+             * @return DEVICE_OK on success.
+             */
+            int setOutput();
+
+            /**
+             * Configures every pin on the bus as a digital input.
+             *
+             * @param pullUp true to enable the internal pull up resistors.
+             *
+             * @return DEVICE_OK on success.
+             */
+            int setInput(bool pullUp = false);
+
+            /**
+             * Drives the given value onto the bus.
+             *
+             * @param value The value to write. Bits beyond the width of the bus are ignored.
+             *
+             * @return DEVICE_OK on success.
+             */
+            int write(uint16_t value);
+
+            /**
+             * Samples every pin on the bus.
+             *
+             * @return the value on the bus.
+             */
+            uint16_t read();
+
+            /**
+             * Writes a sequence of bytes onto the bus, pulsing the given strobe pin after each one.
+             *
+             * The strobe is toggled twice through its PINx register, so it pulses away from whatever
+             * idle level it has been configured with (e.g. LO for an active low WR line).
+             *
+             * By default the strobe is active for a single cycle (62.5ns at 16MHz), and follows the
+             * last port write by only a few cycles. That suits fast latches and 8080 style display
+             * controllers. Slower parts need ATMEGA_PARALLEL_BUS_SETUP_NS and ATMEGA_PARALLEL_BUS_STROBE_NS,
+             * which add busy waits, rounded up to whole cycles, before and during the pulse. An HD44780
+             * class LCD, for example, needs at least 80 and 230 respectively.
+             *
+             * @param buffer The bytes to write.
+             * @param len The number of bytes to write.
+             * @param strobePin An output pin used to latch each byte.
+             *
+             * @return DEVICE_OK on success, or DEVICE_INVALID_PARAMETER if buffer is NULL.
+             */
+            int writeBlock(const uint8_t *buffer, int len, ATMegaPin &strobePin);
+    };
+}
+
+#endif
@@ -36,6 +36,17 @@ DEALINGS IN THE SOFTWARE.
 #define IO_STATUS_EVENT_ON_EDGE             0x20        // Pin will generate events on pin change
 #define IO_STATUS_EVENT_PULSE_ON_EDGE       0x40        // Pin will generate events on pin change
 
+// Decompose a PinNumber into its port index (0 = PORTB, 1 = PORTC, 2 = PORTD) and bit mask.
+#define ATMEGA_PIN_PORT(name)               ((name) >> 3)
+#define ATMEGA_PIN_MASK(name)               (1 << ((name) & 0x07))
+
+/**
+  * Data direction, output and input registers for each port, indexed by ATMEGA_PIN_PORT().
+  */
+extern volatile uint8_t* const DD_REG[];
+extern volatile uint8_t* const PORT_REG[];
+extern volatile uint8_t* const PIN_REG[];
+
 /**
   * Class definition for Pin.
   *
@@ -120,8 +131,9 @@ namespace codal
             /**
              * Configures this IO pin as an analogue input (if necessary), and samples the Pin for its analog value.
              *
-             * @return the current analogue level on the pin, in the range 0 - 1024, or
-             *         DEVICE_NOT_SUPPORTED if the given pin does not have analog capability.
+             * @return the current analogue level on the pin, in the range 0 - 1024, DEVICE_NOT_SUPPORTED
+             *         if the given pin does not have analog capability, or DEVICE_BUSY if an ATMegaADCStream
+             *         is running.
              *
              * @code
              * DevicePin P0(DEVICE_ID_IO_P0, DEVICE_PIN_P0, PIN_CAPABILITY_BOTH);
@@ -130,6 +142,17 @@ namespace codal
              */
             virtual int getAnalogValue();
 
+            /**
+             * Performs a single blocking conversion on the given ADC channel, with a 125khz ADC clock.
+             * Shared by every analog read, which must first configure its pin as an analog input.
+             *
+             * @param channel The ADC channel, 0 - 7.
+             *
+             * @return the level on the channel, in the range 0 - 1023, or DEVICE_BUSY if an
+             *         ATMegaADCStream is running.
+             */
+            static int sampleAnalog(uint8_t channel);
+
             /**
              * Configures the PWM period of the analog output to the given value.
              *
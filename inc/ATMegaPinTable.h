@@ -0,0 +1,131 @@
+/*
+The MIT License (MIT)
+
+Copyright (c) 2017 Lancaster University.
+
+Permission is hereby granted, free of charge, to any person obtaining a
+copy of this software and associated documentation files (the "Software"),
+to deal in the Software without restriction, including without limitation
+the rights to use, copy, modify, merge, publish, distribute, sublicense,
+and/or sell copies of the Software, and to permit persons to whom the
+Software is furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+DEALINGS IN THE SOFTWARE.
+*/
+
+#ifndef ATMEGA_PIN_TABLE_H
+#define ATMEGA_PIN_TABLE_H
+
+#include "CodalConfig.h"
+#include "ATMegaPin.h"
+
+// Number of PinNumbers covered by the table: PORTB, PORTC and PORTD, 8 bits each.
+#define ATMEGA_PIN_TABLE_SIZE               24
+
+// Maximum number of ATMegaPin objects that can be created on demand.
+#ifndef ATMEGA_PIN_TABLE_CACHE_SIZE
+#define ATMEGA_PIN_TABLE_CACHE_SIZE         4
+#endif
+
+// Packed per-pin mode. Digital direction is held by the DDRx registers themselves.
+#define ATMEGA_PIN_TABLE_MODE_DIGITAL       0x00
+#define ATMEGA_PIN_TABLE_MODE_ANALOG_IN     0x01
+#define ATMEGA_PIN_TABLE_MODE_ANALOG_OUT    0x02
+#define ATMEGA_PIN_TABLE_MODE_MASK          0x03
+
+namespace codal
+{
+    /**
+      * Flyweight access to every pin of the device, without an ATMegaPin object per pin.
+      *
+      * Each pin's capabilities are held in a table in program memory, indexed by PinNumber, and
+      * its port and bit follow from the PinNumber itself. The only mutable state held in RAM is
+      * a two bit mode per pin, packed four to a byte, and a bit per pin recording the configured
+      * pull, since PORTx holds the level rather than the pull while a pin is an output. Digital
+      * direction is read back from the port registers.
+      *
+      * An ATMegaPin is created only when code needs a Pin object (for example to pass to a driver),
+      * and is seeded from the current hardware state. Once a pin has an object, operations here
+      * are forwarded to it so that the two views never disagree.
+      *
+      * The table itself takes 17 bytes of RAM with the default cache: 6 bytes of modes, 3 of pulls
+      * and 8 of cache pointers. Each ATMegaPin created adds 13 bytes (11 for the object and 2 for
+      * its heap header).
+      */
+    class ATMegaPinTable
+    {
+        public:
+
+            /**
+             * Determines the capabilities of the given pin.
+             *
+             * @param name The pin.
+             *
+             * @return The pin's capabilities, or 0 if it is not available as an I/O pin.
+             */
+            static PinCapability getCapability(PinNumber name);
+
+            /**
+             * Obtains an ATMegaPin for the given pin, creating it if necessary.
+             *
+             * @param name The pin.
+             *
+             * @return The pin object, or NULL if the pin is not available or the cache is full.
+             */
+            static ATMegaPin *get(PinNumber name);
+
+            /**
+             * Configures the given pin as a digital output (if necessary) and sets its value.
+             *
+             * @param name The pin.
+             * @param value 0 (LO) or 1 (HI)
+             *
+             * @return DEVICE_OK on success, DEVICE_INVALID_PARAMETER if value is out of range, or DEVICE_NOT_SUPPORTED
+             *         if the given pin does not have digital capability.
+             */
+            static int setDigitalValue(PinNumber name, int value);
+
+            /**
+             * Configures the given pin as a digital input (if necessary) and tests its current value.
+             *
+             * @param name The pin.
+             *
+             * @return 1 if this input is high, 0 if input is LO, or DEVICE_NOT_SUPPORTED
+             *         if the given pin does not have digital capability.
+             */
+            static int getDigitalValue(PinNumber name);
+
+            /**
+             * Configures the pull of the given pin. Pull downs are not supported by the hardware,
+             * and are treated as PullMode::None.
+             *
+             * @param name The pin.
+             * @param pull one of the mbed pull configurations: PullUp, PullDown, PullNone
+             *
+             * @return DEVICE_OK on success, or DEVICE_NOT_SUPPORTED if the given pin does not have digital capability.
+             */
+            static int setPull(PinNumber name, PullMode pull);
+
+            /**
+             * Configures the given pin as an analogue input (if necessary), and samples it.
+             *
+             * @param name The pin.
+             *
+             * @return the current analogue level on the pin, in the range 0 - 1023, DEVICE_NOT_SUPPORTED
+             *         if the given pin does not have analog capability, or DEVICE_BUSY if an ATMegaADCStream
+             *         is running.
+             */
+            static int getAnalogValue(PinNumber name);
+    };
+}
+
+#endif
@@ -0,0 +1,132 @@
+/*
+The MIT License (MIT)
+
+Copyright (c) 2017 Lancaster University.
+
+Permission is hereby granted, free of charge, to any person obtaining a
+copy of this software and associated documentation files (the "Software"),
+to deal in the Software without restriction, including without limitation
+the rights to use, copy, modify, merge, publish, distribute, sublicense,
+and/or sell copies of the Software, and to permit persons to whom the
+Software is furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+DEALINGS IN THE SOFTWARE.
+*/
+
+#ifndef ATMEGA_PREEMPTION_H
+#define ATMEGA_PREEMPTION_H
+
+#include "CodalConfig.h"
+
+// Default time slice, in microseconds.
+#ifndef ATMEGA_PREEMPTION_SLICE_US
+#define ATMEGA_PREEMPTION_SLICE_US          4000
+#endif
+
+// The longest time slice that Timer1 compare B can measure, in microseconds.
+#define ATMEGA_PREEMPTION_MAX_SLICE_US      32767
+
+namespace codal
+{
+    /**
+      * Optional preemptive time slicing of fibers.
+      *
+      * Once enabled, Timer1 compare B interrupts every time slice. If the running fiber is inside a
+      * preemptible region, and does not hold the preemption lock, the interrupt calls schedule()
+      * to round robin to the next runnable fiber. Otherwise the switch is deferred until the lock
+      * is released.
+      *
+      * The interrupt prologue saves SREG and every call clobbered register on the fiber's stack, and
+      * swap_context saves the call saved registers and pages the whole stack out, interrupt frame
+      * included, so the fiber later resumes in the interrupt and returns from it as normal.
+      *
+      * Preemption is confined to preemptible regions because the scheduler, the heap and most
+      * of the runtime assume cooperative switching. A region is intended for long running
+      * computation. Code within it must take the preemption lock around any call that allocates
+      * memory or touches state shared with other fibers, and must not block at all: a fiber ends
+      * its region before calling anything that may sleep, wait for an event or yield, and never
+      * blocks while holding the lock. The fibers that are switched to still run cooperatively until
+      * they enter a region of their own.
+      *
+      * The switch itself runs inside the interrupt, with interrupts re-enabled. schedule() and the
+      * stack resize it performs, verify_stack_size() and its heap allocation, therefore execute in
+      * interrupt context whenever a fiber is preempted. This is safe because the lock rule above
+      * guarantees the preempted fiber is not itself inside the heap, but it also means:
+      *
+      * - No other interrupt handler may allocate or free memory, or call into the scheduler.
+      * - The fiber's saved stack includes the interrupt frame, about 17 bytes more than it would
+      *   be at a cooperative yield, and may be reallocated at that depth.
+      * - If that allocation fails the device panics from within the interrupt.
+      */
+
+    /**
+      * Starts preemptive time slicing. Timer1 must already be running as the system timer.
+      *
+      * @param sliceUs The time slice in microseconds, at most ATMEGA_PREEMPTION_MAX_SLICE_US.
+      *
+      * @return DEVICE_OK on success, or DEVICE_INVALID_PARAMETER if the time slice is out of range.
+      */
+    int fiber_preemption_enable(uint16_t sliceUs = ATMEGA_PREEMPTION_SLICE_US);
+
+    /**
+      * Stops preemptive time slicing.
+      */
+    void fiber_preemption_disable();
+
+    /**
+      * Marks the start of a region in which the calling fiber may be preempted.
+      */
+    void fiber_preemptible_begin();
+
+    /**
+      * Marks the end of a preemptible region.
+      */
+    void fiber_preemptible_end();
+
+    /**
+      * Prevents preemption until the matching fiber_preemption_unlock(). Calls may be nested.
+      * Take the lock around allocation and shared state within a preemptible region. The calling
+      * fiber must not block while holding the lock.
+      */
+    void fiber_preemption_lock();
+
+    /**
+      * Releases the preemption lock. If a time slice expired whilst it was held, the calling
+      * fiber yields immediately.
+      */
+    void fiber_preemption_unlock();
+
+    /**
+      * Determines the number of times a fiber has been preempted.
+      */
+    uint16_t fiber_preemption_count();
+
+    /**
+      * Holds the preemption lock for the lifetime of the object.
+      */
+    class PreemptionLock
+    {
+        public:
+
+            PreemptionLock()
+            {
+                fiber_preemption_lock();
+            }
+
+            ~PreemptionLock()
+            {
+                fiber_preemption_unlock();
+            }
+    };
+}
+
+#endif
@@ -0,0 +1,150 @@
+/*
+The MIT License (MIT)
+
+Copyright (c) 2017 Lancaster University.
+
+Permission is hereby granted, free of charge, to any person obtaining a
+copy of this software and associated documentation files (the "Software"),
+to deal in the Software without restriction, including without limitation
+the rights to use, copy, modify, merge, publish, distribute, sublicense,
+and/or sell copies of the Software, and to permit persons to whom the
+Software is furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+DEALINGS IN THE SOFTWARE.
+*/
+
+#ifndef ATMEGA_PULSE_IN_H
+#define ATMEGA_PULSE_IN_H
+
+#include "CodalConfig.h"
+#include "CodalComponent.h"
+#include "ATMegaPin.h"
+
+// Number of measurements buffered per channel. Must be a power of two.
+#ifndef ATMEGA_PULSE_IN_BUFFER_SIZE
+#define ATMEGA_PULSE_IN_BUFFER_SIZE         8
+#endif
+
+// Maximum number of channels that can be measured concurrently through pin change interrupts.
+#ifndef ATMEGA_PULSE_IN_MAX_CHANNELS
+#define ATMEGA_PULSE_IN_MAX_CHANNELS        4
+#endif
+
+// The only pin routed to the Timer1 input capture unit (ICP1 / PB0).
+#define ATMEGA_PULSE_IN_ICP1                0
+
+// Status flags
+#define ATMEGA_PULSE_IN_STATUS_ENABLED      0x01
+#define ATMEGA_PULSE_IN_STATUS_EVENTS       0x02
+#define ATMEGA_PULSE_IN_STATUS_HAVE_RISE    0x04
+#define ATMEGA_PULSE_IN_STATUS_HAVE_FALL    0x08
+
+namespace codal
+{
+    /**
+      * A single pulse measurement, in Timer1 ticks (0.5us).
+      */
+    struct PulseMeasurement
+    {
+        uint16_t    width;      // Time the pin spent HI.
+        uint16_t    period;     // Time between consecutive rising edges.
+    };
+
+    /**
+      * Class definition for a hardware timestamped pulse width and frequency meter.
+      *
+      * Edges are timestamped against the free running Timer1 count maintained by ATMegaTimer.
+      * The ICP1 pin is captured by the input capture unit, so its timestamps are exact. Any other
+      * pin falls back to a pin change interrupt that reads TCNT1 on entry.
+      *
+      * Pulses of up to 32ms can be measured. Completed measurements are queued in a ring buffer,
+      * and can also be raised as DEVICE_PIN_EVT_PULSE_HI / DEVICE_PIN_EVT_PULSE_LO events
+      * from the pin's id, with the pulse duration in microseconds held in the event timestamp.
+      */
+    class ATMegaPulseIn : public CodalComponent
+    {
+        private:
+
+            ATMegaPin           &pin;
+            uint16_t            lastRise;
+            uint16_t            lastFall;
+            volatile uint8_t    head;
+            volatile uint8_t    tail;
+            volatile uint16_t   overruns;
+            PulseMeasurement    buffer[ATMEGA_PULSE_IN_BUFFER_SIZE];
+
+        public:
+
+            /**
+             * Constructor.
+             * Create a pulse meter on the given pin. Measurement does not begin until enable() is called.
+             *
+             * @param pin The pin to measure. Timestamps are exact if this is ATMEGA_PULSE_IN_ICP1.
+             */
+            ATMegaPulseIn(ATMegaPin &pin);
+
+            /**
+             * Destructor. Stops any measurement in progress.
+             */
+            ~ATMegaPulseIn();
+
+            /**
+             * Configures the pin as a digital input and starts timestamping its edges.
+             *
+             * @return DEVICE_OK on success, or DEVICE_NO_RESOURCES if all pin change channels are in use.
+             */
+            int enable();
+
+            /**
+             * Stops timestamping edges on the pin.
+             *
+             * @return DEVICE_OK on success.
+             */
+            int disable();
+
+            /**
+             * Determines if measurements are also raised as events on the message bus.
+             *
+             * @param enabled true to raise DEVICE_PIN_EVT_PULSE_HI / DEVICE_PIN_EVT_PULSE_LO events.
+             */
+            void setEventsEnabled(bool enabled);
+
+            /**
+             * Determines the number of completed measurements waiting to be read.
+             */
+            int available();
+
+            /**
+             * Removes the oldest completed measurement from the buffer.
+             *
+             * @param m The structure to populate.
+             *
+             * @return DEVICE_OK on success, or DEVICE_NO_DATA if the buffer is empty.
+             */
+            int read(PulseMeasurement &m);
+
+            /**
+             * Determines the number of measurements discarded because the buffer was full.
+             */
+            uint16_t getOverruns();
+
+            /**
+             * Records an edge on the pin. Called from interrupt context.
+             *
+             * @param rising non-zero if the pin is now HI.
+             * @param timestamp The Timer1 count at which the edge occurred.
+             */
+            void onEdge(uint8_t rising, uint16_t timestamp);
+    };
+}
+
+#endif
@@ -0,0 +1,140 @@
+/*
+The MIT License (MIT)
+
+Copyright (c) 2017 Lancaster University.
+
+Permission is hereby granted, free of charge, to any person obtaining a
+copy of this software and associated documentation files (the "Software"),
+to deal in the Software without restriction, including without limitation
+the rights to use, copy, modify, merge, publish, distribute, sublicense,
+and/or sell copies of the Software, and to permit persons to whom the
+Software is furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+DEALINGS IN THE SOFTWARE.
+*/
+
+#ifndef ATMEGA_SPI_H
+#define ATMEGA_SPI_H
+
+#include "CodalConfig.h"
+#include "codal-core/inc/driver-models/SPI.h"
+#include "ATMegaPin.h"
+
+namespace codal
+{
+typedef void (*PVoidCallback)(void *);
+
+/**
+  * Class definition for ATMega SPI master device.
+  *
+  * The hardware SPI pins are fixed: MOSI (PB3), MISO (PB4) and SCK (PB5). SS (PB2) is configured
+  * as an output, as the hardware would otherwise drop out of master mode when it is pulled LO.
+  */
+class ATMegaSPI : public SPI
+{
+    const uint8_t   *txBuffer;
+    uint8_t         *rxBuffer;
+    uint16_t        txSize;
+    uint16_t        rxSize;
+    uint16_t        length;
+    volatile uint16_t index;
+
+    PVoidCallback   doneHandler;
+    void            *doneHandlerArg;
+
+public:
+
+    /**
+      * Constructor.
+      * Configures the SPI peripheral as a master in mode 0 at 1MHz.
+      *
+      * @param mosi The MOSI pin (PB3).
+      * @param miso The MISO pin (PB4).
+      * @param sclk The SCK pin (PB5).
+      */
+    ATMegaSPI(ATMegaPin &mosi, ATMegaPin &miso, ATMegaPin &sclk);
+
+    /** Set the frequency of the SPI interface
+      *
+      * The nearest available frequency (F_CPU / 2^n, from F_CPU/2 to F_CPU/128) at or below
+      * the one requested is used.
+      *
+      * @param frequency The bus frequency in hertz
+      */
+    virtual int setFrequency(uint32_t frequency);
+
+    /** Set the mode of the SPI interface
+      *
+      * @param mode Clock polarity and phase mode (0 - 3)
+      * @param bits Number of bits per SPI frame. Only 8 is supported.
+      *
+      * @return DEVICE_OK on success, DEVICE_INVALID_PARAMETER if mode is out of range,
+      *         or DEVICE_NOT_SUPPORTED if bits is not 8.
+      */
+    virtual int setMode(int mode, int bits = 8);
+
+    /**
+      * Writes the given byte to the SPI bus.
+      *
+      * The CPU will busy wait until the transmission is complete.
+      *
+      * @param data The data to write.
+      * @return Response from the SPI slave, or DEVICE_BUSY if an asynchronous transfer is in progress.
+      */
+    virtual int write(int data);
+
+    /**
+      * Writes and reads from the SPI bus concurrently. Waits until the transfer is complete.
+      *
+      * Either buffer can be NULL. Bytes beyond txSize are sent as 0xFF, and bytes received beyond
+      * rxSize are discarded.
+      *
+      * @param txBuffer The bytes to send.
+      * @param txSize The number of bytes to send.
+      * @param rxBuffer Where to store received bytes.
+      * @param rxSize The number of bytes to receive.
+      *
+      * @return DEVICE_OK on success, or DEVICE_BUSY if an asynchronous transfer is in progress.
+      */
+    virtual int transfer(const uint8_t *txBuffer, uint32_t txSize, uint8_t *rxBuffer, uint32_t rxSize);
+
+    /**
+      * Starts an interrupt driven transfer, and returns immediately.
+      *
+      * Each byte is moved by the SPI_STC interrupt, so this is best suited to long transfers
+      * where the CPU has other work to do. The buffers must remain valid until the transfer completes.
+      *
+      * @param txBuffer The bytes to send.
+      * @param txSize The number of bytes to send.
+      * @param rxBuffer Where to store received bytes.
+      * @param rxSize The number of bytes to receive.
+      * @param doneHandler Called from interrupt context once the transfer completes. May be NULL.
+      * @param arg Passed to doneHandler.
+      *
+      * @return DEVICE_OK on success, or DEVICE_BUSY if a transfer is already in progress.
+      */
+    virtual int startTransfer(const uint8_t *txBuffer, uint32_t txSize, uint8_t *rxBuffer, uint32_t rxSize,
+                              PVoidCallback doneHandler, void *arg);
+
+    /**
+      * Determines if an asynchronous transfer is in progress.
+      */
+    int isBusy();
+
+    /**
+      * Moves the next byte of an asynchronous transfer. Called from the SPI_STC interrupt.
+      */
+    void irq();
+};
+}
+
+#endif
@@ -28,6 +28,29 @@ DEALINGS IN THE SOFTWARE.
 #include "CodalConfig.h"
 #include "CodalComponent.h"
 #include "Pin.h"
+#include <avr/pgmspace.h>
+#include <stdarg.h>
+
+/**
+  * Marker type for strings held in program memory.
+  */
+class __FlashStringHelper;
+
+/**
+  * Places a string literal in program memory, and marks it as such for ATMegaSerial::send().
+  *
+  * @code
+  * serial.send(F("Hello World\n"));
+  * @endcode
+  */
+#ifndef F
+#define F(s) (reinterpret_cast<const __FlashStringHelper *>(PSTR(s)))
+#endif
+
+// Formatting flags for numeric output.
+#define ATMEGA_SERIAL_FORMAT_ZERO_PAD       0x01        // Pad with leading zeros rather than spaces.
+#define ATMEGA_SERIAL_FORMAT_LEFT           0x02        // Left justify within the field width.
+#define ATMEGA_SERIAL_FORMAT_UPPER          0x04        // Use upper case hexadecimal digits.
 
 
 /**
@@ -39,6 +62,10 @@ namespace codal
     {
         private:
 
+            void sendRepeated(char c, uint8_t count);
+            int sendFormatted(uint32_t n, uint8_t negative, uint8_t base, uint8_t width, uint8_t flags, uint8_t decimals);
+            int format(const char *fmt, bool flash, va_list args);
+
         public:
 
             /**
@@ -66,6 +93,38 @@ namespace codal
              */
             int send(const char *s);
 
+            /**
+             *
+             * Send the given program memory string on this serial port.
+             * The string is read directly from flash, so it need not occupy any RAM.
+             * This function will wait for any previous communication to complete before sending.
+             *
+             * @param s The string to send, as created by the F() macro.
+             * @return DEVICE_OK on success.
+             */
+            int send(const __FlashStringHelper *s);
+
+            /**
+             *
+             * Send the given program memory string on this serial port.
+             * This function will wait for any previous communication to complete before sending.
+             *
+             * @param s A pointer into program memory, such as one created by PSTR() or declared PROGMEM.
+             * @return DEVICE_OK on success.
+             */
+            int sendP(PGM_P s);
+
+            /**
+             *
+             * Send a block of bytes held in program memory, such as a PROGMEM table, on this serial port.
+             * This function will wait for any previous communication to complete before sending.
+             *
+             * @param buffer A pointer into program memory.
+             * @param len The number of bytes to send.
+             * @return DEVICE_OK on success.
+             */
+            int sendP(const void *buffer, int len);
+
             /**
              *
              * Send the given number on this serial port.
@@ -76,6 +135,81 @@ namespace codal
              */
             int send(const uint16_t n);
 
+            /**
+             *
+             * Send the given signed number in decimal on this serial port.
+             * This function will wait for any previous communication to complete before sending.
+             *
+             * @param n The number to send
+             * @param width The minimum number of characters to send, including any sign.
+             * @param flags ATMEGA_SERIAL_FORMAT_ZERO_PAD and/or ATMEGA_SERIAL_FORMAT_LEFT.
+             * @return DEVICE_OK on success.
+             */
+            int sendDec(int32_t n, uint8_t width = 0, uint8_t flags = 0);
+
+            /**
+             *
+             * Send the given unsigned number in decimal on this serial port.
+             * This function will wait for any previous communication to complete before sending.
+             *
+             * @param n The number to send
+             * @param width The minimum number of characters to send.
+             * @param flags ATMEGA_SERIAL_FORMAT_ZERO_PAD and/or ATMEGA_SERIAL_FORMAT_LEFT.
+             * @return DEVICE_OK on success.
+             */
+            int sendUnsigned(uint32_t n, uint8_t width = 0, uint8_t flags = 0);
+
+            /**
+             *
+             * Send the given number in hexadecimal on this serial port, without a prefix.
+             * This function will wait for any previous communication to complete before sending.
+             *
+             * @param n The number to send
+             * @param width The minimum number of digits to send.
+             * @param flags Any ATMEGA_SERIAL_FORMAT flags.
+             * @return DEVICE_OK on success.
+             */
+            int sendHex(uint32_t n, uint8_t width = 0, uint8_t flags = ATMEGA_SERIAL_FORMAT_ZERO_PAD | ATMEGA_SERIAL_FORMAT_UPPER);
+
+            /**
+             *
+             * Send the given fixed point number in decimal on this serial port.
+             * This function will wait for any previous communication to complete before sending.
+             *
+             * @param n The number to send, scaled by 10^decimals (e.g. 2150 with 2 decimals is sent as 21.50).
+             * @param decimals The number of digits after the decimal point, from 0 to 9.
+             * @param width The minimum number of characters to send, including sign and decimal point.
+             * @param flags ATMEGA_SERIAL_FORMAT_ZERO_PAD and/or ATMEGA_SERIAL_FORMAT_LEFT.
+             * @return DEVICE_OK on success, or DEVICE_INVALID_PARAMETER if decimals is out of range.
+             */
+            int sendFixed(int32_t n, uint8_t decimals, uint8_t width = 0, uint8_t flags = 0);
+
+            /**
+             *
+             * Send formatted text on this serial port.
+             * This function will wait for any previous communication to complete before sending.
+             *
+             * A subset of printf is supported: %d %i %u %x %X %c %s %%, with the '-' and '0' flags,
+             * a field width, and the 'l' modifier for 32 bit values. %S sends a program memory string.
+             *
+             * Digits are generated most significant first by repeated subtraction of powers of ten,
+             * so no buffer or 32 bit division routine is needed, and the only data is a 40 byte PROGMEM
+             * table.
+             *
+             * @param fmt The format string.
+             * @return DEVICE_OK on success.
+             */
+            int printf(const char *fmt, ...);
+
+            /**
+             *
+             * Send formatted text on this serial port, using a format string held in program memory.
+             *
+             * @param fmt The format string, as created by the F() macro.
+             * @return DEVICE_OK on success.
+             */
+            int printf(const __FlashStringHelper *fmt, ...);
+
             /**
              * Configures this serial port for the givn board rate.
              *
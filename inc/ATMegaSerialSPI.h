@@ -0,0 +1,120 @@
+/*
+The MIT License (MIT)
+
+Copyright (c) 2017 Lancaster University.
+
+Permission is hereby granted, free of charge, to any person obtaining a
+copy of this software and associated documentation files (the "Software"),
+to deal in the Software without restriction, including without limitation
+the rights to use, copy, modify, merge, publish, distribute, sublicense,
+and/or sell copies of the Software, and to permit persons to whom the
+Software is furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+DEALINGS IN THE SOFTWARE.
+*/
+
+#ifndef ATMEGA_SERIAL_SPI_H
+#define ATMEGA_SERIAL_SPI_H
+
+#include "CodalConfig.h"
+#include "codal-core/inc/driver-models/SPI.h"
+#include "ATMegaPin.h"
+
+namespace codal
+{
+
+/**
+  * Class definition for USART0 operating in Master SPI Mode (MSPIM).
+  *
+  * Unlike the SPI peripheral, the USART transmitter is double buffered, so the next byte can be
+  * queued whilst the current one is shifted out, and back-to-back bytes are sent with no gap
+  * between them. This makes it well suited to streaming display data, whilst the hardware SPI
+  * remains free for other devices.
+  *
+  * The USART is shared with ATMegaSerial, so only one of the two may be used at a time.
+  * Data is sent on TXD (PD1), received on RXD (PD0) and clocked on XCK (PD4).
+  */
+class ATMegaSerialSPI : public SPI
+{
+public:
+
+    /**
+      * Constructor.
+      * Configures USART0 as an SPI master in mode 0 at 1MHz.
+      *
+      * @param mosi The TXD pin (PD1).
+      * @param miso The RXD pin (PD0).
+      * @param sclk The XCK pin (PD4).
+      */
+    ATMegaSerialSPI(ATMegaPin &mosi, ATMegaPin &miso, ATMegaPin &sclk);
+
+    /** Set the frequency of the SPI interface
+      *
+      * The nearest available frequency (F_CPU / 2(n+1)) at or below the one requested is used,
+      * up to a maximum of F_CPU/2.
+      *
+      * @param frequency The bus frequency in hertz
+      */
+    virtual int setFrequency(uint32_t frequency);
+
+    /** Set the mode of the SPI interface
+      *
+      * @param mode Clock polarity and phase mode (0 - 3)
+      * @param bits Number of bits per SPI frame. Only 8 is supported.
+      *
+      * @return DEVICE_OK on success, DEVICE_INVALID_PARAMETER if mode is out of range,
+      *         or DEVICE_NOT_SUPPORTED if bits is not 8.
+      */
+    virtual int setMode(int mode, int bits = 8);
+
+    /**
+      * Writes the given byte to the SPI bus.
+      *
+      * The CPU will busy wait until the transmission is complete.
+      *
+      * @param data The data to write.
+      * @return Response from the SPI slave.
+      */
+    virtual int write(int data);
+
+    /**
+      * Writes and reads from the SPI bus concurrently. Waits until the transfer is complete.
+      *
+      * The transmitter is kept one byte ahead of the receiver, so bytes are sent back to back.
+      * Either buffer can be NULL. Bytes beyond txSize are sent as 0xFF, and bytes received beyond
+      * rxSize are discarded.
+      *
+      * @param txBuffer The bytes to send.
+      * @param txSize The number of bytes to send.
+      * @param rxBuffer Where to store received bytes.
+      * @param rxSize The number of bytes to receive.
+      *
+      * @return DEVICE_OK on success.
+      */
+    virtual int transfer(const uint8_t *txBuffer, uint32_t txSize, uint8_t *rxBuffer, uint32_t rxSize);
+
+    /**
+      * Streams the given bytes onto the bus, discarding anything received.
+      *
+      * The receiver is disabled for the duration, so the only work per byte is refilling the
+      * transmit buffer. Waits until the last byte has been shifted out.
+      *
+      * @param buffer The bytes to send.
+      * @param len The number of bytes to send.
+      *
+      * @return DEVICE_OK on success, or DEVICE_INVALID_PARAMETER if buffer is NULL.
+      */
+    int send(const uint8_t *buffer, uint32_t len);
+};
+}
+
+#endif
@@ -0,0 +1,171 @@
+/*
+The MIT License (MIT)
+
+Copyright (c) 2017 Lancaster University.
+
+Permission is hereby granted, free of charge, to any person obtaining a
+copy of this software and associated documentation files (the "Software"),
+to deal in the Software without restriction, including without limitation
+the rights to use, copy, modify, merge, publish, distribute, sublicense,
+and/or sell copies of the Software, and to permit persons to whom the
+Software is furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+DEALINGS IN THE SOFTWARE.
+*/
+
+#ifndef ATMEGA_STACK_POOL_H
+#define ATMEGA_STACK_POOL_H
+
+#include "CodalConfig.h"
+
+// Buffers are allocated in power of two size classes, from 1 << ATMEGA_STACK_POOL_MIN_SHIFT bytes upwards.
+#ifndef ATMEGA_STACK_POOL_MIN_SHIFT
+#define ATMEGA_STACK_POOL_MIN_SHIFT         4
+#endif
+
+#ifndef ATMEGA_STACK_POOL_CLASSES
+#define ATMEGA_STACK_POOL_CLASSES           6
+#endif
+
+#define ATMEGA_STACK_POOL_MAX_BLOCK         (1 << (ATMEGA_STACK_POOL_MIN_SHIFT + ATMEGA_STACK_POOL_CLASSES - 1))
+
+// Each block carries a one byte header.
+#define ATMEGA_STACK_POOL_MAX_BUFFER        (ATMEGA_STACK_POOL_MAX_BLOCK - 1)
+
+// Total RAM reserved for fiber stack save buffers. Must be a multiple of ATMEGA_STACK_POOL_MAX_BLOCK.
+#ifndef ATMEGA_STACK_POOL_SIZE
+#define ATMEGA_STACK_POOL_SIZE              ATMEGA_STACK_POOL_MAX_BLOCK
+#endif
+
+/**
+  * Usage statistics for the stack pool.
+  */
+struct StackPoolStats
+{
+    uint16_t    arenaSize;                              // Bytes reserved for the pool.
+    uint16_t    arenaUsed;                              // Bytes in allocated blocks, including headers and rounding.
+    uint16_t    peakUsed;                               // Most bytes ever allocated at once.
+    uint16_t    largestFree;                            // Size of the largest free block.
+    uint16_t    allocations;                            // Successful allocations.
+    uint16_t    failures;                               // Allocations that could not be satisfied.
+    uint8_t     inUse[ATMEGA_STACK_POOL_CLASSES];       // Blocks currently allocated in each class.
+    uint8_t     peak[ATMEGA_STACK_POOL_CLASSES];        // Most blocks ever allocated at once in each class.
+    uint8_t     free[ATMEGA_STACK_POOL_CLASSES];        // Free blocks in each class.
+};
+
+/**
+  * A buddy allocator for the buffers that fiber stacks are paged into by swap_context.
+  *
+  * The arena is divided into power of two blocks. A request is served from the smallest free block
+  * that fits, splitting larger blocks in half as needed, and a freed block is merged with its buddy
+  * whenever both halves are free. Space released by one size class is therefore reusable by any
+  * other, so a stack that grows and later shrinks or exits leaves no fragments behind. Allocation and
+  * release take at most one step per size class. Each block is preceded by a single byte holding
+  * its size class, and free blocks are tagged so their buddy can find them.
+  *
+  * These functions are C callable. The scheduler's stack resize path (verify_stack_size() in
+  * codal-core) is the intended caller, through stack_pool_resize():
+  *
+  * @code
+  * uint16_t capacity;
+  * void *buffer = stack_pool_resize((void *)f->stack_bottom, stackDepth, &capacity);
+  * if (buffer == NULL)
+  *     target_panic(DEVICE_OOM);
+  * f->stack_bottom = (PROCESSOR_WORD_TYPE)buffer;
+  * f->stack_top = f->stack_bottom + capacity;
+  * @endcode
+  *
+  * with stack_pool_free() in place of free() when a fiber is released.
+  */
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+  * Allocates a buffer of at least the given size.
+  *
+  * @param size The number of bytes needed, at most ATMEGA_STACK_POOL_MAX_BUFFER.
+  *
+  * @return A pointer to the buffer, or NULL if the pool is exhausted.
+  */
+void *stack_pool_alloc(uint16_t size);
+
+/**
+  * Returns a buffer to the pool, merging it with any free buddy.
+  *
+  * @param buffer A buffer from the pool, or NULL.
+  */
+void stack_pool_free(void *buffer);
+
+/**
+  * Determines the usable size of a buffer.
+  *
+  * @param buffer A buffer from the pool, or NULL.
+  *
+  * @return The number of bytes available in the buffer.
+  */
+uint16_t stack_pool_capacity(void *buffer);
+
+/**
+  * Ensures a stack buffer can hold the given number of bytes.
+  *
+  * Returns the existing buffer if it is already large enough. Otherwise the old buffer is released
+  * first, so that its space can merge into the replacement, and a buffer of the smallest class that
+  * fits is allocated. Classes are powers of two, so a growing stack at least doubles its buffer each
+  * time. The contents are not preserved, as the scheduler saves the stack again after resizing.
+  *
+  * @param buffer The current buffer, or NULL.
+  * @param size The number of bytes needed.
+  *
+  * @return The buffer to use, or NULL if the pool is exhausted, in which case the old buffer has
+  *         been released.
+  */
+void *stack_pool_grow(void *buffer, uint16_t size);
+
+/**
+  * Reduces a buffer to the smallest class that holds the given number of bytes, in place.
+  * The upper halves released are merged back into the pool. The contents up to size are preserved.
+  *
+  * @param buffer A buffer from the pool.
+  * @param size The number of bytes still needed.
+  *
+  * @return buffer, which is unchanged.
+  */
+void *stack_pool_shrink(void *buffer, uint16_t size);
+
+/**
+  * The port hook for the scheduler's stack resize path.
+  *
+  * Grows the buffer if the stack no longer fits. Shrinks it if the stack would fit in a quarter of it,
+  * leaving room for the stack to double before it must grow again, so a fiber whose depth oscillates
+  * does not reallocate on every switch.
+  *
+  * @param buffer The fiber's current buffer, or NULL.
+  * @param depth The depth of the fiber's stack, in bytes.
+  * @param capacity Set to the usable size of the buffer returned.
+  *
+  * @return The buffer to use, or NULL if the pool is exhausted.
+  */
+void *stack_pool_resize(void *buffer, uint16_t depth, uint16_t *capacity);
+
+/**
+  * Takes a snapshot of the pool's usage statistics.
+  *
+  * @param stats The structure to fill in.
+  */
+void stack_pool_get_stats(struct StackPoolStats *stats);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,140 @@
+/*
+The MIT License (MIT)
+
+Copyright (c) 2017 Lancaster University.
+
+Permission is hereby granted, free of charge, to any person obtaining a
+copy of this software and associated documentation files (the "Software"),
+to deal in the Software without restriction, including without limitation
+the rights to use, copy, modify, merge, publish, distribute, sublicense,
+and/or sell copies of the Software, and to permit persons to whom the
+Software is furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+DEALINGS IN THE SOFTWARE.
+*/
+
+#ifndef ATMEGA_TELEMETRY_H
+#define ATMEGA_TELEMETRY_H
+
+#include "CodalConfig.h"
+#include "ATMegaSerial.h"
+
+// Largest record payload, in bytes (excluding the type byte and CRC).
+#ifndef ATMEGA_TELEMETRY_MAX_PAYLOAD
+#define ATMEGA_TELEMETRY_MAX_PAYLOAD        32
+#endif
+
+// Frame layout before encoding: type, payload, CRC-16 (little endian).
+#define ATMEGA_TELEMETRY_FRAME_SIZE         (ATMEGA_TELEMETRY_MAX_PAYLOAD + 3)
+
+// Byte used to delimit encoded frames on the wire.
+#define ATMEGA_TELEMETRY_DELIMITER          0x00
+
+namespace codal
+{
+    /**
+      * Class definition for a binary telemetry channel over an ATMegaSerial port.
+      *
+      * Each record is a type byte followed by a payload of little endian fields, and a CRC-16
+      * (CCITT, polynomial 0x1021, initial value 0xFFFF) over both. The frame is COBS encoded, so
+      * it contains no zero bytes, and terminated by a zero. A receiver can therefore resynchronise
+      * at the next zero after any corruption, and discard damaged frames by their CRC.
+      *
+      * COBS adds one byte per 254 and the frame adds four, so a record of three 16 bit samples
+      * takes 11 bytes on the wire, against 21 as "0xNNNN " hex text.
+      *
+      * A host side decoder is provided in tools/telemetry/decode.py.
+      *
+      * @code
+      * telemetry.begin(1);
+      * telemetry.putU16(pin.getAnalogValue());
+      * telemetry.putI32(counter);
+      * telemetry.end();
+      * @endcode
+      */
+    class ATMegaTelemetry
+    {
+        private:
+
+            ATMegaSerial    &serial;
+            uint8_t         length;
+            uint8_t         buffer[ATMEGA_TELEMETRY_FRAME_SIZE];
+
+        public:
+
+            /**
+             * Constructor.
+             *
+             * @param serial The serial port to send frames on.
+             */
+            ATMegaTelemetry(ATMegaSerial &serial);
+
+            /**
+             * Starts a new record, discarding any record in progress.
+             *
+             * @param type The record type, identifying the layout of its payload to the receiver.
+             */
+            void begin(uint8_t type);
+
+            /**
+             * Appends fields to the record in progress.
+             *
+             * @return DEVICE_OK on success, or DEVICE_NO_RESOURCES if the payload is full.
+             */
+            int putU8(uint8_t value);
+            int putU16(uint16_t value);
+            int putI16(int16_t value);
+            int putU32(uint32_t value);
+            int putI32(int32_t value);
+            int putFloat(float value);
+
+            /**
+             * Appends raw bytes to the record in progress.
+             *
+             * @param data The bytes to append.
+             * @param len The number of bytes.
+             *
+             * @return DEVICE_OK on success, or DEVICE_NO_RESOURCES if the payload is full.
+             */
+            int put(const void *data, uint8_t len);
+
+            /**
+             * Completes the record in progress, and sends it as a single frame.
+             *
+             * @return DEVICE_OK on success.
+             */
+            int end();
+
+            /**
+             * Sends a complete record in one call.
+             *
+             * @param type The record type.
+             * @param data The payload.
+             * @param len The length of the payload.
+             *
+             * @return DEVICE_OK on success, or DEVICE_INVALID_PARAMETER if the payload is too long.
+             */
+            int send(uint8_t type, const void *data, uint8_t len);
+
+            /**
+             * Computes the CRC-16 used by this protocol, four bits at a time from a 16 entry table.
+             *
+             * @param data The bytes to checksum.
+             * @param len The number of bytes.
+             *
+             * @return the CRC.
+             */
+            static uint16_t crc16(const uint8_t *data, uint8_t len);
+    };
+}
+
+#endif
@@ -28,8 +28,39 @@ DEALINGS IN THE SOFTWARE.
 #include "Timer.h"
 #include "ErrorNo.h"
 
+// Sleep modes used by ATMegaTimer::idle(), indexing TimerSleepStats.
+#define ATMEGA_TIMER_SLEEP_IDLE             0
+#define ATMEGA_TIMER_SLEEP_ADC              1
+#define ATMEGA_TIMER_SLEEP_POWER_SAVE       2
+#define ATMEGA_TIMER_SLEEP_MODES            3
+
+// Define ATMEGA_TIMER2_ASYNC on boards with a 32.768kHz crystal on TOSC1/TOSC2 (so the CPU runs from its
+// internal oscillator). Timer2 then keeps time whilst Timer1 is stopped in ADC noise reduction and power-save.
+#ifdef ATMEGA_TIMER2_ASYNC
+
+// Timer2 is clocked at 32768Hz / 8.
+#define ATMEGA_TIMER2_HZ                    4096
+
+// Shortest wait worth entering a mode that stops Timer1, in microseconds.
+#ifndef ATMEGA_TIMER_MIN_DEEP_SLEEP_US
+#define ATMEGA_TIMER_MIN_DEEP_SLEEP_US      1000
+#endif
+
+#endif
+
 namespace codal
 {
+    /**
+      * Sleep statistics, gathered by ATMegaTimer::idle().
+      */
+    struct TimerSleepStats
+    {
+        uint32_t    sleepUs[ATMEGA_TIMER_SLEEP_MODES];      // Total time spent asleep in each mode.
+        uint16_t    count[ATMEGA_TIMER_SLEEP_MODES];        // Number of times each mode was entered.
+        uint16_t    wakeLatency;                            // Last wake up latency, in Timer1 ticks (0.5us).
+        uint16_t    maxWakeLatency;                         // Worst wake up latency, in Timer1 ticks (0.5us).
+    };
+
 	class ATMegaTimer : public Timer
 	{
 	public:
@@ -58,11 +89,49 @@ namespace codal
 
         void start();
 
-        uint16_t    period;
-        uint16_t    sigma;
+        /**
+         * Sleeps until the next interrupt, in the deepest mode compatible with the peripherals in use.
+         * Intended to be called from the scheduler's idle loop, whenever every fiber is blocked,
+         * through atmega_timer_idle().
+         *
+         * Idle mode is used by default. ADC noise reduction and power-save stop Timer1, so are used only
+         * when ATMEGA_TIMER2_ASYNC is defined, the next timer event is at least ATMEGA_TIMER_MIN_DEEP_SLEEP_US
+         * away, and no peripheral that needs the I/O clock is active. Timer2 then wakes the CPU in time for
+         * the next event, and the time slept is added to the system time on waking.
+         */
+        void idle();
+
+        /**
+         * Retrieves the statistics gathered by idle().
+         *
+         * @param stats The structure to fill in.
+         */
+        void getSleepStats(TimerSleepStats *stats);
+
+        uint16_t    period;         // Interval until the next compare match, in Timer1 ticks (0.5us).
+        uint16_t    sigma;          // Value of the free running Timer1 count at the last sync.
         uint16_t    running;
 
+        volatile uint8_t    sleeping;       // Set whilst idle() is asleep, so the wake up ISR can measure its latency.
+        uint16_t            sleepStart;     // Timer1 count on entering sleep.
+        TimerSleepStats     stats;
+
 	};
+
+    /**
+      * Sleeps until the next interrupt via the system timer's idle(), if one has been created.
+      *
+      * The port hook for the scheduler's idle loop. codal-core's idle fiber calls target_wait_for_event()
+      * whenever every fiber is blocked, so the target's HAL implements that as:
+      *
+      * @code
+      * void target_wait_for_event()
+      * {
+      *     atmega_timer_idle();
+      * }
+      * @endcode
+      */
+    void atmega_timer_idle();
 }
 
 #endif
@@ -0,0 +1,138 @@
+/*
+The MIT License (MIT)
+
+Copyright (c) 2017 Lancaster University.
+
+Permission is hereby granted, free of charge, to any person obtaining a
+copy of this software and associated documentation files (the "Software"),
+to deal in the Software without restriction, including without limitation
+the rights to use, copy, modify, merge, publish, distribute, sublicense,
+and/or sell copies of the Software, and to permit persons to whom the
+Software is furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+DEALINGS IN THE SOFTWARE.
+*/
+
+#ifndef ATMEGA_TOUCH_SENSOR_H
+#define ATMEGA_TOUCH_SENSOR_H
+
+#include "CodalConfig.h"
+#include "CodalComponent.h"
+#include "ATMegaPin.h"
+
+// Maximum number of pins a single sensor can measure.
+#ifndef ATMEGA_TOUCH_MAX_PINS
+#define ATMEGA_TOUCH_MAX_PINS               8
+#endif
+
+// Number of port samples taken after the pins are released. Must be a multiple of 8.
+#ifndef ATMEGA_TOUCH_WINDOW
+#define ATMEGA_TOUCH_WINDOW                 64
+#endif
+
+// Number of charge measurements summed into each reading.
+#ifndef ATMEGA_TOUCH_REPEATS
+#define ATMEGA_TOUCH_REPEATS                4
+#endif
+
+// Time the pins are held LO to discharge before each measurement, in microseconds.
+#ifndef ATMEGA_TOUCH_DISCHARGE_US
+#define ATMEGA_TOUCH_DISCHARGE_US           4
+#endif
+
+// Default increase in reading over the baseline that is considered a touch.
+#ifndef ATMEGA_TOUCH_THRESHOLD
+#define ATMEGA_TOUCH_THRESHOLD              6
+#endif
+
+// The baseline moves 1/(2^n) of the way towards each untouched reading.
+#define ATMEGA_TOUCH_BASELINE_SHIFT         4
+
+namespace codal
+{
+    /**
+      * Class definition for a multi-pin capacitive touch sensor.
+      *
+      * Touch pads are sensed by their charge time. All pads on a port are discharged, then
+      * released together onto their internal pull ups, whilst the port is sampled into a buffer
+      * every few CPU cycles. The index of the first HI sample for each pad is its charge time,
+      * so every pad on a port is measured at once.
+      *
+      * Readings are taken on each system tick. Each pad tracks its own baseline whilst untouched,
+      * and raises DEVICE_BUTTON_EVT_DOWN / DEVICE_BUTTON_EVT_UP events from the pin's id.
+      */
+    class ATMegaTouchSensor : public CodalComponent
+    {
+        private:
+
+            uint8_t     count;
+            uint8_t     touched;
+            uint8_t     threshold;
+            ATMegaPin   *pins[ATMEGA_TOUCH_MAX_PINS];
+            uint16_t    reading[ATMEGA_TOUCH_MAX_PINS];
+            uint16_t    baseline[ATMEGA_TOUCH_MAX_PINS];
+
+            int indexOf(ATMegaPin &pin);
+
+        public:
+
+            /**
+             * Constructor.
+             * Create a touch sensor with no pins.
+             *
+             * @param id The unique EventModel id of this component.
+             * @param threshold The increase in reading over the baseline that is considered a touch.
+             */
+            ATMegaTouchSensor(uint16_t id, uint8_t threshold = ATMEGA_TOUCH_THRESHOLD);
+
+            /**
+             * Configures the given pin as a touch input (IO_STATUS_TOUCH_IN), and begins sensing it.
+             *
+             * @param pin The pin attached to the touch pad.
+             *
+             * @return DEVICE_OK on success, DEVICE_NOT_SUPPORTED if the pin has no digital capability,
+             *         or DEVICE_NO_RESOURCES if the sensor is full.
+             */
+            int addPin(ATMegaPin &pin);
+
+            /**
+             * Measures every pad, updating baselines and raising events as necessary.
+             */
+            void scan();
+
+            /**
+             * Resets the baseline of every pad to its current reading.
+             */
+            void calibrate();
+
+            /**
+             * Determines if the given pad is currently touched.
+             *
+             * @return 1 if touched, 0 if not, or DEVICE_INVALID_PARAMETER if the pin is not sensed.
+             */
+            int isTouched(ATMegaPin &pin);
+
+            /**
+             * Obtains the most recent raw reading of the given pad.
+             *
+             * @return the summed charge time, in port samples, or DEVICE_INVALID_PARAMETER if the pin is not sensed.
+             */
+            int getReading(ATMegaPin &pin);
+
+            /**
+             * Periodic callback, used to scan the pads in the background.
+             */
+            virtual void periodicCallback();
+    };
+}
+
+#endif
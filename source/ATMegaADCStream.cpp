@@ -0,0 +1,277 @@
+/*
+The MIT License (MIT)
+
+Copyright (c) 2017 Lancaster University.
+
+Permission is hereby granted, free of charge, to any person obtaining a
+copy of this software and associated documentation files (the "Software"),
+to deal in the Software without restriction, including without limitation
+the rights to use, copy, modify, merge, publish, distribute, sublicense,
+and/or sell copies of the Software, and to permit persons to whom the
+Software is furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+DEALINGS IN THE SOFTWARE.
+*/
+
+#include "ATMegaADCStream.h"
+#include "ErrorNo.h"
+#include <avr/io.h>
+#include <avr/interrupt.h>
+
+#if ATMEGA_ADC_STREAM_BLOCK_SIZE + ATMEGA_ADC_STREAM_HEADER_SIZE > 255
+#error "ATMEGA_ADC_STREAM_BLOCK_SIZE is too large"
+#endif
+
+#if ATMEGA_ADC_STREAM_BLOCK_SIZE & 1
+#error "ATMEGA_ADC_STREAM_BLOCK_SIZE must be even"
+#endif
+
+using namespace codal;
+
+static ATMegaADCStream *instance = NULL;
+
+// Timer0 prescalers, indexed by their CS0 bits - 1.
+static const uint16_t TIMER0_PRESCALE[] = {1, 8, 64, 256, 1024};
+
+/**
+  * Constructor.
+  *
+  * @param pin The analog pin to sample.
+  */
+ATMegaADCStream::ATMegaADCStream(ATMegaPin &pin) : pin(pin)
+{
+    this->txBlock = ATMEGA_ADC_STREAM_NONE;
+    this->sent = 0;
+    this->dropped = 0;
+
+    instance = this;
+}
+
+/**
+  * Starts sampling and streaming.
+  *
+  * @param sampleRate The number of samples per second.
+  * @param tenBit true to send full 10 bit samples as two bytes, false to send the top 8 bits.
+  *
+  * @return DEVICE_OK on success, DEVICE_NOT_SUPPORTED if the pin is not an ADC input, or
+  *         DEVICE_INVALID_PARAMETER if the sample rate cannot be generated by Timer0
+  *         or exceeds the conversion rate of the ADC.
+  */
+int ATMegaADCStream::start(uint32_t sampleRate, bool tenBit)
+{
+    // Only port C is connected to the ADC multiplexer.
+    if (ATMEGA_PIN_PORT(pin.name) != 1)
+        return DEVICE_NOT_SUPPORTED;
+
+    if (sampleRate == 0)
+        return DEVICE_INVALID_PARAMETER;
+
+    // Use the slowest Timer0 clock that can still represent the period in 8 bits, for the best resolution.
+    uint8_t cs = 0;
+    uint32_t top = 0;
+
+    while (cs < sizeof(TIMER0_PRESCALE) / sizeof(TIMER0_PRESCALE[0]))
+    {
+        top = F_CPU / ((uint32_t)TIMER0_PRESCALE[cs] * sampleRate);
+        if (top <= 256)
+            break;
+
+        cs++;
+    }
+
+    if (top == 0 || top > 256)
+        return DEVICE_INVALID_PARAMETER;
+
+    // Use the slowest ADC clock (and so the most accurate conversion) that keeps up with the trigger.
+    // An auto triggered conversion takes 13.5 ADC clocks, so allow 14.
+    uint8_t adps = 7;
+    while (adps >= 4 && (F_CPU >> adps) / 14 < sampleRate)
+        adps--;
+
+    if (adps < 4)
+        return DEVICE_INVALID_PARAMETER;
+
+    stop();
+
+    uint8_t mask = ATMEGA_PIN_MASK(pin.name);
+    DDRC &= ~mask;
+    PORTC &= ~mask;
+    DIDR0 |= mask;
+
+    fillBlock = 0;
+    fillPosition = 0;
+    nextSequence = 0;
+    sent = 0;
+    dropped = 0;
+
+    status = ATMEGA_ADC_STREAM_STATUS_RUNNING | (tenBit ? ATMEGA_ADC_STREAM_STATUS_10BIT : 0);
+
+    // Left adjust 8 bit samples, so that only ADCH needs to be read.
+    ADMUX = (1 << REFS0) | (tenBit ? 0 : (1 << ADLAR)) | (pin.name & 0x07);
+
+    // Trigger conversions from Timer0 compare match A.
+    ADCSRB = (1 << ADTS1) | (1 << ADTS0);
+    ADCSRA = (1 << ADEN) | (1 << ADATE) | (1 << ADIF) | (1 << ADIE) | adps;
+
+    UCSR0B |= (1 << TXEN0);
+
+    TCCR0B = 0;
+    TCNT0 = 0;
+    OCR0A = top - 1;
+    TIFR0 = (1 << OCF0A);
+    TCCR0A = (1 << WGM01);
+    TCCR0B = cs + 1;
+
+    // Ensure a later call to getAnalogValue() reconfigures the ADC.
+    pin.status &= ~IO_STATUS_ANALOG_IN;
+
+    return DEVICE_OK;
+}
+
+/**
+  * Stops sampling. A block already being transmitted is allowed to complete, whilst a
+  * partially filled block is discarded.
+  *
+  * @return DEVICE_OK on success.
+  */
+int ATMegaADCStream::stop()
+{
+    if (!(status & ATMEGA_ADC_STREAM_STATUS_RUNNING))
+        return DEVICE_OK;
+
+    TCCR0B = 0;
+
+    // Return to the single conversion, 125khz ADC clock configuration that ATMegaPin expects.
+    ADCSRA = (ADCSRA & ~((1 << ADATE) | (1 << ADIE) | (1 << ADPS2) | (1 << ADPS1) | (1 << ADPS0)))
+             | (1 << ADIF) | (1 << ADPS2) | (1 << ADPS1) | (1 << ADPS0);
+    ADCSRB = 0;
+    ADMUX &= ~(1 << ADLAR);
+
+    DIDR0 &= ~ATMEGA_PIN_MASK(pin.name);
+
+    status &= ~(ATMEGA_ADC_STREAM_STATUS_RUNNING | ATMEGA_ADC_STREAM_STATUS_10BIT);
+
+    return DEVICE_OK;
+}
+
+/**
+  * Determines the number of blocks transmitted since start().
+  */
+uint16_t ATMegaADCStream::getSentBlocks()
+{
+    uint8_t sreg = SREG;
+    cli();
+    uint16_t s = sent;
+    SREG = sreg;
+
+    return s;
+}
+
+/**
+  * Determines the number of blocks dropped since start(), because the transmitter had not
+  * finished sending the previous block.
+  */
+uint16_t ATMegaADCStream::getDroppedBlocks()
+{
+    uint8_t sreg = SREG;
+    cli();
+    uint16_t d = dropped;
+    SREG = sreg;
+
+    return d;
+}
+
+/**
+  * Stores the latest sample. Called from the ADC interrupt.
+  */
+void ATMegaADCStream::sampleIrq()
+{
+    // The trigger is edge sensitive: clear the compare flag so the next match starts a conversion.
+    TIFR0 = (1 << OCF0A);
+
+    uint8_t *block = buffer[fillBlock];
+    uint8_t position = fillPosition;
+
+    if (status & ATMEGA_ADC_STREAM_STATUS_10BIT)
+    {
+        // ADCL must be read first.
+        block[position++] = ADCL;
+        block[position++] = ADCH;
+    }
+    else
+    {
+        block[position++] = ADCH;
+    }
+
+    if (position >= ATMEGA_ADC_STREAM_BLOCK_SIZE)
+    {
+        position = 0;
+        sequence[fillBlock] = nextSequence++;
+
+        if (txBlock == ATMEGA_ADC_STREAM_NONE)
+        {
+            txBlock = fillBlock;
+            txPosition = 0;
+            fillBlock ^= 1;
+            UCSR0B |= (1 << UDRIE0);
+        }
+        else
+        {
+            // The other block is still being sent, so overwrite this one.
+            dropped++;
+        }
+    }
+
+    fillPosition = position;
+}
+
+/**
+  * Sends the next byte of the current block. Called from the USART data register empty interrupt.
+  */
+void ATMegaADCStream::transmitIrq()
+{
+    uint8_t position = txPosition;
+
+    if (position == 0)
+        UDR0 = ATMEGA_ADC_STREAM_SYNC0;
+    else if (position == 1)
+        UDR0 = ATMEGA_ADC_STREAM_SYNC1;
+    else if (position == 2)
+        UDR0 = sequence[txBlock];
+    else
+        UDR0 = buffer[txBlock][position - ATMEGA_ADC_STREAM_HEADER_SIZE];
+
+    position++;
+
+    if (position >= ATMEGA_ADC_STREAM_BLOCK_SIZE + ATMEGA_ADC_STREAM_HEADER_SIZE)
+    {
+        UCSR0B &= ~(1 << UDRIE0);
+        txBlock = ATMEGA_ADC_STREAM_NONE;
+        sent++;
+    }
+
+    txPosition = position;
+}
+
+ISR(ADC_vect)
+{
+    if (instance)
+        instance->sampleIrq();
+}
+
+ISR(USART_UDRE_vect)
+{
+    if (instance)
+        instance->transmitIrq();
+    else
+        UCSR0B &= ~(1 << UDRIE0);
+}
@@ -0,0 +1,426 @@
+/*
+The MIT License (MIT)
+
+Copyright (c) 2017 Lancaster University.
+
+Permission is hereby granted, free of charge, to any person obtaining a
+copy of this software and associated documentation files (the "Software"),
+to deal in the Software without restriction, including without limitation
+the rights to use, copy, modify, merge, publish, distribute, sublicense,
+and/or sell copies of the Software, and to permit persons to whom the
+Software is furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+DEALINGS IN THE SOFTWARE.
+*/
+
+#include "ATMegaEEPROMStore.h"
+#include "CodalFiber.h"
+#include "ErrorNo.h"
+#include "Event.h"
+#include <avr/io.h>
+#include <avr/interrupt.h>
+#include <util/crc16.h>
+#include <string.h>
+
+#if ((E2END + 1) % ATMEGA_EEPROM_STORE_SLOT_SIZE) != 0
+#error "The EEPROM size must be a multiple of ATMEGA_EEPROM_STORE_SLOT_SIZE"
+#endif
+
+// The write position runs one past the end of the slot, for the key byte, and must fit in a byte.
+#if ATMEGA_EEPROM_STORE_SLOT_SIZE > 254
+#error "ATMEGA_EEPROM_STORE_SLOT_SIZE must be at most 254"
+#endif
+
+#define EEPROM_BUSY (EECR & (1 << EEPE))
+
+// Programming modes (EEPM1:0)
+#define EEPROM_MODE_ERASE_WRITE     0x00
+#define EEPROM_MODE_ERASE           (1 << EEPM0)
+#define EEPROM_MODE_WRITE           (1 << EEPM1)
+
+using namespace codal;
+
+static ATMegaEEPROMStore *instance = NULL;
+
+ISR(EE_READY_vect)
+{
+    if (instance)
+        instance->irq();
+}
+
+/**
+  * Reads a byte of EEPROM. Must be called with interrupts disabled and no write in progress.
+  */
+static inline uint8_t eeprom_read(uint16_t address)
+{
+    EEAR = address;
+    EECR |= (1 << EERE);
+
+    return EEDR;
+}
+
+/**
+  * Constructor.
+  * Scans the EEPROM to rebuild the index of current records.
+  *
+  * @param id The unique EventModel id of this component.
+  */
+ATMegaEEPROMStore::ATMegaEEPROMStore(uint16_t id)
+{
+    uint16_t sequences[ATMEGA_EEPROM_STORE_MAX_KEYS];
+    int newest = -1;
+
+    this->id = id;
+    this->status = 0;
+
+    current = NULL;
+    sequence = 0;
+
+    for (int k = 0; k < ATMEGA_EEPROM_STORE_MAX_KEYS; k++)
+        index[k] = ATMEGA_EEPROM_STORE_NONE;
+
+    for (int q = 0; q < ATMEGA_EEPROM_STORE_QUEUE_SIZE; q++)
+        queue[q].key = ATMEGA_EEPROM_STORE_NONE;
+
+    while (EEPROM_BUSY);
+
+    for (int s = 0; s < ATMEGA_EEPROM_STORE_SLOTS; s++)
+    {
+        uint16_t base = s * ATMEGA_EEPROM_STORE_SLOT_SIZE;
+        uint8_t key = eeprom_read(base);
+        uint8_t len = eeprom_read(base + 1);
+        uint8_t c = 0;
+
+        if (key >= ATMEGA_EEPROM_STORE_MAX_KEYS || len > ATMEGA_EEPROM_STORE_VALUE_SIZE)
+            continue;
+
+        for (int i = 0; i < ATMEGA_EEPROM_STORE_SLOT_SIZE - 1; i++)
+            c = _crc8_ccitt_update(c, eeprom_read(base + i));
+
+        if (c != eeprom_read(base + ATMEGA_EEPROM_STORE_SLOT_SIZE - 1))
+            continue;
+
+        uint16_t seq = eeprom_read(base + 2) | ((uint16_t)eeprom_read(base + 3) << 8);
+
+        if (index[key] == ATMEGA_EEPROM_STORE_NONE || (int16_t)(seq - sequences[key]) > 0)
+        {
+            index[key] = s;
+            sequences[key] = seq;
+        }
+
+        if (newest < 0 || (int16_t)(seq - sequence) > 0)
+        {
+            newest = s;
+            sequence = seq;
+        }
+    }
+
+    // Resume writing just after the most recent record.
+    head = (newest + 1) % ATMEGA_EEPROM_STORE_SLOTS;
+
+    instance = this;
+}
+
+/**
+  * Determines the byte at the given offset of the slot image for the record being written.
+  */
+uint8_t ATMegaEEPROMStore::imageByte(uint8_t offset)
+{
+    if (offset == 0)
+        return current->key;
+
+    if (offset == 1)
+        return current->len;
+
+    if (offset == 2)
+        return sequence & 0xff;
+
+    if (offset == 3)
+        return sequence >> 8;
+
+    if (offset == ATMEGA_EEPROM_STORE_SLOT_SIZE - 1)
+        return crc;
+
+    offset -= ATMEGA_EEPROM_STORE_HEADER_SIZE;
+
+    // Pad with the erased value, so unused bytes rarely need programming.
+    return offset < current->len ? current->value[offset] : 0xff;
+}
+
+/**
+  * Selects the next queued value to write, and the slot to write it to.
+  *
+  * @return 1 if a record is ready to write, or 0 if the queue is empty.
+  */
+int ATMegaEEPROMStore::nextEntry()
+{
+    current = NULL;
+
+    for (int q = 0; q < ATMEGA_EEPROM_STORE_QUEUE_SIZE; q++)
+    {
+        if (queue[q].key != ATMEGA_EEPROM_STORE_NONE)
+        {
+            current = &queue[q];
+            break;
+        }
+    }
+
+    if (current == NULL)
+        return 0;
+
+    // Find the next slot round the EEPROM that does not hold a current record.
+    // There are always more slots than keys, so one will be free.
+    slot = head;
+
+    for (int k = 0; k < ATMEGA_EEPROM_STORE_MAX_KEYS; k++)
+    {
+        if (index[k] == slot)
+        {
+            slot = (slot + 1) % ATMEGA_EEPROM_STORE_SLOTS;
+            k = -1;
+        }
+    }
+
+    sequence++;
+    offset = 0;
+
+    crc = 0;
+    for (uint8_t i = 0; i < ATMEGA_EEPROM_STORE_SLOT_SIZE - 1; i++)
+        crc = _crc8_ccitt_update(crc, imageByte(i));
+
+    return 1;
+}
+
+/**
+  * Programs the next byte of the current record. Called from the EE_READY interrupt,
+  * which fires whenever the EEPROM is idle and the interrupt is enabled.
+  */
+void ATMegaEEPROMStore::irq()
+{
+    while (1)
+    {
+        if (current == NULL && !nextEntry())
+        {
+            EECR &= ~(1 << EERIE);
+            Event(id, ATMEGA_EEPROM_STORE_EVT_SYNCED);
+            return;
+        }
+
+        // The key byte is erased first and programmed last, one step after the CRC. Until then the
+        // scan rejects the slot, so a write torn by a reset cannot pass for a record with a stale CRC.
+        while (offset <= ATMEGA_EEPROM_STORE_SLOT_SIZE)
+        {
+            uint8_t position = offset < ATMEGA_EEPROM_STORE_SLOT_SIZE ? offset : 0;
+            uint16_t address = slot * ATMEGA_EEPROM_STORE_SLOT_SIZE + position;
+            uint8_t value = offset == 0 ? 0xff : imageByte(position);
+            uint8_t old = eeprom_read(address);
+
+            offset++;
+
+            if (old != value)
+            {
+                uint8_t mode = EEPROM_MODE_ERASE_WRITE;
+
+                // Erasing sets bits, writing clears them. Only do what is needed.
+                if (value == 0xff)
+                    mode = EEPROM_MODE_ERASE;
+                else if ((old & value) == value)
+                    mode = EEPROM_MODE_WRITE;
+
+                EEDR = value;
+                EECR = mode | (1 << EERIE) | (1 << EEMPE);
+                EECR |= (1 << EEPE);
+                return;
+            }
+        }
+
+        // The record is complete, so it now replaces any previous value of its key.
+        index[current->key] = slot;
+        head = (slot + 1) % ATMEGA_EEPROM_STORE_SLOTS;
+
+        current->key = ATMEGA_EEPROM_STORE_NONE;
+        current = NULL;
+    }
+}
+
+/**
+  * Queues a value to be written to the given key.
+  *
+  * @param key The key to write, in the range 0 .. ATMEGA_EEPROM_STORE_MAX_KEYS - 1.
+  * @param data The value to store.
+  * @param len The length of the value, at most ATMEGA_EEPROM_STORE_VALUE_SIZE bytes.
+  *
+  * @return DEVICE_OK on success, DEVICE_INVALID_PARAMETER if the key or length are out of range,
+  *         or DEVICE_NO_RESOURCES if the write queue is full.
+  */
+int ATMegaEEPROMStore::put(uint8_t key, const void *data, uint8_t len)
+{
+    EEPROMStoreEntry *entry = NULL;
+    EEPROMStoreEntry *unused = NULL;
+
+    if (key >= ATMEGA_EEPROM_STORE_MAX_KEYS || len > ATMEGA_EEPROM_STORE_VALUE_SIZE || (len && data == NULL))
+        return DEVICE_INVALID_PARAMETER;
+
+    uint8_t sreg = SREG;
+    cli();
+
+    // Coalesce with any write to this key that has not yet started.
+    for (int q = 0; q < ATMEGA_EEPROM_STORE_QUEUE_SIZE; q++)
+    {
+        if (queue[q].key == key && &queue[q] != current)
+            entry = &queue[q];
+
+        if (queue[q].key == ATMEGA_EEPROM_STORE_NONE && unused == NULL)
+            unused = &queue[q];
+    }
+
+    if (entry == NULL)
+    {
+        // If the EEPROM is idle, it can be read without delay. Skip writes that would change nothing.
+        if (!(EECR & (1 << EERIE)) && !EEPROM_BUSY && index[key] != ATMEGA_EEPROM_STORE_NONE)
+        {
+            uint16_t base = index[key] * ATMEGA_EEPROM_STORE_SLOT_SIZE;
+            int same = (eeprom_read(base + 1) == len);
+
+            for (int i = 0; same && i < len; i++)
+                same = (eeprom_read(base + ATMEGA_EEPROM_STORE_HEADER_SIZE + i) == ((const uint8_t *)data)[i]);
+
+            if (same)
+            {
+                SREG = sreg;
+                return DEVICE_OK;
+            }
+        }
+
+        if (unused == NULL)
+        {
+            SREG = sreg;
+            return DEVICE_NO_RESOURCES;
+        }
+
+        entry = unused;
+    }
+
+    entry->key = key;
+    entry->len = len;
+
+    if (len)
+        memcpy(entry->value, data, len);
+
+    // Start the writer, if it is not already running.
+    EECR |= (1 << EERIE);
+
+    SREG = sreg;
+
+    return DEVICE_OK;
+}
+
+/**
+  * Reads the value of the given key, including any write still queued.
+  *
+  * @param key The key to read.
+  * @param data Where to store the value.
+  * @param len The size of the buffer at data.
+  *
+  * @return the length of the value, DEVICE_NO_DATA if the key has no value,
+  *         or DEVICE_INVALID_PARAMETER if the key is out of range.
+  */
+int ATMegaEEPROMStore::get(uint8_t key, void *data, uint8_t len)
+{
+    EEPROMStoreEntry *entry = NULL;
+    uint8_t *out = (uint8_t *)data;
+    int result;
+
+    if (key >= ATMEGA_EEPROM_STORE_MAX_KEYS || (len && data == NULL))
+        return DEVICE_INVALID_PARAMETER;
+
+    uint8_t sreg = SREG;
+    cli();
+
+    // EEPROM cannot be read whilst a byte is being programmed (up to 3.4ms). Hold off the writer,
+    // so it does not start another byte, and wait for the current one with interrupts enabled.
+    uint8_t writer = EECR & (1 << EERIE);
+    EECR &= ~(1 << EERIE);
+
+    while (EEPROM_BUSY)
+    {
+        SREG = sreg;
+        while (EEPROM_BUSY);
+        cli();
+
+        // A put() whilst we waited may have restarted the writer.
+        writer |= EECR & (1 << EERIE);
+        EECR &= ~(1 << EERIE);
+    }
+
+    // The newest value is a queued write, then one being written, then the EEPROM.
+    // The queue is only examined now, as put() may have changed it whilst we waited.
+    for (int q = 0; q < ATMEGA_EEPROM_STORE_QUEUE_SIZE; q++)
+        if (queue[q].key == key && (entry == NULL || entry == current))
+            entry = &queue[q];
+
+    if (entry)
+    {
+        result = entry->len;
+        memcpy(out, entry->value, result < len ? result : len);
+    }
+    else if (index[key] != ATMEGA_EEPROM_STORE_NONE)
+    {
+        uint16_t base = index[key] * ATMEGA_EEPROM_STORE_SLOT_SIZE;
+
+        result = eeprom_read(base + 1);
+        for (int i = 0; i < result && i < len; i++)
+            out[i] = eeprom_read(base + ATMEGA_EEPROM_STORE_HEADER_SIZE + i);
+    }
+    else
+    {
+        result = 0;
+    }
+
+    // Resume the writer, including for any write put() queued whilst we waited.
+    for (int q = 0; q < ATMEGA_EEPROM_STORE_QUEUE_SIZE; q++)
+        if (queue[q].key != ATMEGA_EEPROM_STORE_NONE)
+            writer = (1 << EERIE);
+
+    EECR |= writer;
+
+    SREG = sreg;
+
+    return result ? result : DEVICE_NO_DATA;
+}
+
+/**
+  * Removes the value of the given key.
+  *
+  * @return DEVICE_OK on success, or as put().
+  */
+int ATMegaEEPROMStore::remove(uint8_t key)
+{
+    return put(key, NULL, 0);
+}
+
+/**
+  * Determines if any writes are waiting to reach the EEPROM.
+  */
+int ATMegaEEPROMStore::isBusy()
+{
+    return (EECR & (1 << EERIE)) ? 1 : 0;
+}
+
+/**
+  * Blocks the calling fiber until every queued write has reached the EEPROM.
+  */
+void ATMegaEEPROMStore::sync()
+{
+    while (isBusy())
+        fiber_sleep(4);
+}
@@ -0,0 +1,256 @@
+/*
+The MIT License (MIT)
+
+Copyright (c) 2017 Lancaster University.
+
+Permission is hereby granted, free of charge, to any person obtaining a
+copy of this software and associated documentation files (the "Software"),
+to deal in the Software without restriction, including without limitation
+the rights to use, copy, modify, merge, publish, distribute, sublicense,
+and/or sell copies of the Software, and to permit persons to whom the
+Software is furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+DEALINGS IN THE SOFTWARE.
+*/
+
+#include "ATMegaI2CSlave.h"
+#include "Event.h"
+#include "ErrorNo.h"
+#include <avr/io.h>
+#include <avr/interrupt.h>
+#include <avr/pgmspace.h>
+
+// Slave receiver status codes.
+#define TWSR_MASK               0xF8
+#define TWSR_SR_ADDR_ACK        0x60
+#define TWSR_SR_ARB_ADDR_ACK    0x68
+#define TWSR_SR_DATA_ACK        0x80
+#define TWSR_SR_DATA_NACK       0x88
+#define TWSR_SR_STOP            0xA0
+
+// Slave transmitter status codes.
+#define TWSR_ST_ADDR_ACK        0xA8
+#define TWSR_ST_ARB_ADDR_ACK    0xB0
+#define TWSR_ST_DATA_ACK        0xB8
+#define TWSR_ST_DATA_NACK       0xC0
+#define TWSR_ST_LAST_DATA       0xC8
+
+#define TWSR_BUS_ERROR          0x00
+
+// Release the bus and acknowledge our address / the next byte.
+#define TWCR_ACK                ((1 << TWINT) | (1 << TWEA) | (1 << TWEN) | (1 << TWIE))
+
+using namespace codal;
+
+static ATMegaI2CSlave *instance = NULL;
+
+/**
+  * Constructor.
+  * Releases the given pins to the TWI, which drives them directly once enabled.
+  *
+  * @param sda The pin to use for SDA, which must be PC4.
+  * @param scl The pin to use for SCL, which must be PC5.
+  * @param id The unique EventModel id of this component.
+  */
+ATMegaI2CSlave::ATMegaI2CSlave(ATMegaPin &sda, ATMegaPin &scl, uint16_t id)
+{
+    this->id = id;
+    this->status = 0;
+
+    if (sda.name == ATMEGA_I2C_SLAVE_SDA && scl.name == ATMEGA_I2C_SLAVE_SCL)
+    {
+        // Leave both lines as plain inputs, so nothing but the TWI (and the bus pull ups) drives them.
+        uint8_t mask = ATMEGA_PIN_MASK(sda.name) | ATMEGA_PIN_MASK(scl.name);
+        DDRC &= ~mask;
+        PORTC &= ~mask;
+
+        sda.status = 0;
+        scl.status = 0;
+
+        this->status = ATMEGA_I2C_SLAVE_STATUS_PINS;
+    }
+
+    this->registers = NULL;
+    this->flags = NULL;
+    this->length = 0;
+    this->pointer = 0;
+    this->callback = NULL;
+
+    instance = this;
+}
+
+/**
+  * Defines the register map exposed to the bus master.
+  *
+  * @param registers The register values.
+  * @param length The number of registers, at most 255.
+  * @param flags Optional array in program memory holding ATMEGA_I2C_SLAVE_READ_ONLY /
+  *              ATMEGA_I2C_SLAVE_NOTIFY flags for each register, or NULL for all writable.
+  *
+  * @return DEVICE_OK on success.
+  */
+int ATMegaI2CSlave::setRegisters(uint8_t *registers, uint8_t length, const uint8_t *flags)
+{
+    uint8_t sreg = SREG;
+    cli();
+
+    this->registers = registers;
+    this->length = registers ? length : 0;
+    this->flags = flags;
+    this->pointer = 0;
+
+    SREG = sreg;
+
+    return DEVICE_OK;
+}
+
+/**
+  * Sets the function invoked when a register flagged ATMEGA_I2C_SLAVE_NOTIFY is written.
+  *
+  * The callback runs in interrupt context, and so must be brief.
+  *
+  * @param callback The function to call, or NULL.
+  */
+void ATMegaI2CSlave::setWriteCallback(I2CSlaveWriteCallback callback)
+{
+    uint8_t sreg = SREG;
+    cli();
+    this->callback = callback;
+    SREG = sreg;
+}
+
+/**
+  * Starts responding to the given 7 bit address.
+  *
+  * @param address The slave address.
+  *
+  * @return DEVICE_OK on success, DEVICE_INVALID_PARAMETER if the address is out of range, or
+  *         DEVICE_NOT_SUPPORTED if the pins given to the constructor are not the TWI pins.
+  */
+int ATMegaI2CSlave::enable(uint8_t address)
+{
+    if (!(status & ATMEGA_I2C_SLAVE_STATUS_PINS))
+        return DEVICE_NOT_SUPPORTED;
+
+    if (address == 0 || address > 0x7F)
+        return DEVICE_INVALID_PARAMETER;
+
+    // Respond only to our own address, not the general call.
+    TWAR = address << 1;
+    TWAMR = 0;
+    TWCR = TWCR_ACK;
+
+    status = ATMEGA_I2C_SLAVE_STATUS_PINS | ATMEGA_I2C_SLAVE_STATUS_ENABLED;
+
+    return DEVICE_OK;
+}
+
+/**
+  * Stops responding to the bus.
+  *
+  * @return DEVICE_OK on success.
+  */
+int ATMegaI2CSlave::disable()
+{
+    TWCR = 0;
+    TWAR = 0;
+
+    status = ATMEGA_I2C_SLAVE_STATUS_PINS;
+
+    return DEVICE_OK;
+}
+
+/**
+  * Services the TWI. Called from the TWI interrupt.
+  */
+void ATMegaI2CSlave::irq()
+{
+    uint8_t p = pointer;
+
+    switch (TWSR & TWSR_MASK)
+    {
+        case TWSR_SR_ADDR_ACK:
+        case TWSR_SR_ARB_ADDR_ACK:
+            // The first byte written is the register address.
+            status |= ATMEGA_I2C_SLAVE_STATUS_POINTER;
+            break;
+
+        case TWSR_SR_DATA_ACK:
+        {
+            uint8_t data = TWDR;
+
+            if (status & ATMEGA_I2C_SLAVE_STATUS_POINTER)
+            {
+                status &= ~ATMEGA_I2C_SLAVE_STATUS_POINTER;
+                p = data;
+                break;
+            }
+
+            if (p < length)
+            {
+                uint8_t f = flags ? pgm_read_byte(&flags[p]) : 0;
+
+                if (!(f & ATMEGA_I2C_SLAVE_READ_ONLY))
+                {
+                    registers[p] = data;
+                    status |= ATMEGA_I2C_SLAVE_STATUS_WRITTEN;
+
+                    if ((f & ATMEGA_I2C_SLAVE_NOTIFY) && callback)
+                        callback(p, data);
+                }
+
+                p++;
+            }
+            break;
+        }
+
+        case TWSR_SR_STOP:
+            // A STOP or a repeated START: the TWI does not say which, so either ends a write.
+            if (status & ATMEGA_I2C_SLAVE_STATUS_WRITTEN)
+            {
+                status &= ~ATMEGA_I2C_SLAVE_STATUS_WRITTEN;
+                Event(id, ATMEGA_I2C_SLAVE_EVT_WRITE);
+            }
+            break;
+
+        case TWSR_ST_ADDR_ACK:
+        case TWSR_ST_ARB_ADDR_ACK:
+        case TWSR_ST_DATA_ACK:
+            if (p < length)
+                TWDR = registers[p++];
+            else
+                TWDR = 0xFF;
+            break;
+
+        case TWSR_BUS_ERROR:
+            // Release the bus and return to the unaddressed state.
+            TWCR = TWCR_ACK | (1 << TWSTO);
+            return;
+
+        case TWSR_SR_DATA_NACK:
+        case TWSR_ST_DATA_NACK:
+        case TWSR_ST_LAST_DATA:
+        default:
+            break;
+    }
+
+    pointer = p;
+    TWCR = TWCR_ACK;
+}
+
+ISR(TWI_vect)
+{
+    if (instance)
+        instance->irq();
+    else
+        TWCR = 0;
+}
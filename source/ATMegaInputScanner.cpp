@@ -0,0 +1,215 @@
+/*
+The MIT License (MIT)
+
+Copyright (c) 2017 Lancaster University.
+
+Permission is hereby granted, free of charge, to any person obtaining a
+copy of this software and associated documentation files (the "Software"),
+to deal in the Software without restriction, including without limitation
+the rights to use, copy, modify, merge, publish, distribute, sublicense,
+and/or sell copies of the Software, and to permit persons to whom the
+Software is furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+DEALINGS IN THE SOFTWARE.
+*/
+
+#include "ATMegaInputScanner.h"
+#include "Button.h"
+#include "ErrorNo.h"
+#include "Event.h"
+#include <avr/io.h>
+#include <util/delay.h>
+
+#define INPUT_SCANNER_MATRIX_KEY    0xFF
+
+using namespace codal;
+
+/**
+  * Constructor.
+  * Create a scanner with no inputs.
+  *
+  * @param id The event id of the first key. Key n raises events from id + n.
+  */
+ATMegaInputScanner::ATMegaInputScanner(uint16_t id)
+{
+    this->id = id;
+    this->status = 0;
+
+    keys = 0;
+    activeLow = 0;
+    matrixBase = 0;
+    rowCount = 0;
+    colCount = 0;
+
+    state = 0;
+    cnt0 = 0;
+    cnt1 = 0;
+}
+
+/**
+  * Adds a single pin as a key, configured as a digital input.
+  *
+  * @param pin The pin to scan.
+  * @param activeLow true if the key pulls the pin LO when pressed. The internal pull up is enabled.
+  *
+  * @return the index of the new key, or DEVICE_NO_RESOURCES if no keys remain.
+  */
+int ATMegaInputScanner::addInput(ATMegaPin &pin, bool activeLow)
+{
+    if (keys >= ATMEGA_INPUT_SCANNER_MAX_KEYS)
+        return DEVICE_NO_RESOURCES;
+
+    pin.setPull(activeLow ? PullMode::Up : PullMode::None);
+    pin.getDigitalValue();
+
+    inputs[keys] = pin.name;
+
+    if (activeLow)
+        this->activeLow |= ((uint32_t)1 << keys);
+
+    status |= DEVICE_COMPONENT_STATUS_SYSTEM_TICK;
+
+    return keys++;
+}
+
+/**
+  * Adds a key matrix. Rows are driven LO one at a time, and columns read with their pull ups enabled.
+  * Key (r, c) is assigned the index returned plus (r * colCount) + c.
+  *
+  * @param rowPins The row pins.
+  * @param rowCount The number of rows.
+  * @param colPins The column pins.
+  * @param colCount The number of columns.
+  *
+  * @return the index of the first key in the matrix, DEVICE_INVALID_PARAMETER if a matrix has already
+  *         been added or has too many lines, or DEVICE_NO_RESOURCES if not enough keys remain.
+  */
+int ATMegaInputScanner::addMatrix(ATMegaPin **rowPins, int rowCount, ATMegaPin **colPins, int colCount)
+{
+    if (this->rowCount || rowCount <= 0 || colCount <= 0 || rowCount > ATMEGA_INPUT_SCANNER_MAX_LINES || colCount > ATMEGA_INPUT_SCANNER_MAX_LINES)
+        return DEVICE_INVALID_PARAMETER;
+
+    if (keys + rowCount * colCount > ATMEGA_INPUT_SCANNER_MAX_KEYS)
+        return DEVICE_NO_RESOURCES;
+
+    // Rows idle as floating inputs, with their output latch held LO so that
+    // setting the data direction bit alone selects the row.
+    for (int r = 0; r < rowCount; r++)
+    {
+        rowPins[r]->setPull(PullMode::None);
+        rowPins[r]->getDigitalValue();
+        rows[r] = rowPins[r]->name;
+    }
+
+    for (int c = 0; c < colCount; c++)
+    {
+        colPins[c]->setPull(PullMode::Up);
+        colPins[c]->getDigitalValue();
+        cols[c] = colPins[c]->name;
+    }
+
+    matrixBase = keys;
+
+    for (int k = 0; k < rowCount * colCount; k++)
+        inputs[keys++] = INPUT_SCANNER_MATRIX_KEY;
+
+    this->rowCount = rowCount;
+    this->colCount = colCount;
+
+    status |= DEVICE_COMPONENT_STATUS_SYSTEM_TICK;
+
+    return matrixBase;
+}
+
+/**
+  * Takes a raw sample of every key, with bit n set if key n is currently pressed.
+  */
+uint32_t ATMegaInputScanner::sample()
+{
+    uint8_t ports[3] = {PINB, PINC, PIND};
+    uint32_t levels = 0;
+    uint32_t pressed;
+
+    for (int k = 0; k < keys; k++)
+        if (inputs[k] != INPUT_SCANNER_MATRIX_KEY && (ports[ATMEGA_PIN_PORT(inputs[k])] & ATMEGA_PIN_MASK(inputs[k])))
+            levels |= ((uint32_t)1 << k);
+
+    pressed = levels ^ activeLow;
+
+    // Matrix keys read LO when pressed. Drive each row in turn and sample every column.
+    for (int r = 0; r < rowCount; r++)
+    {
+        volatile uint8_t *dd = DD_REG[ATMEGA_PIN_PORT(rows[r])];
+        uint8_t mask = ATMEGA_PIN_MASK(rows[r]);
+
+        *dd |= mask;
+        _delay_us(ATMEGA_INPUT_SCANNER_SETTLE_US);
+
+        ports[0] = PINB;
+        ports[1] = PINC;
+        ports[2] = PIND;
+
+        *dd &= ~mask;
+
+        for (int c = 0; c < colCount; c++)
+            if (!(ports[ATMEGA_PIN_PORT(cols[c])] & ATMEGA_PIN_MASK(cols[c])))
+                pressed |= ((uint32_t)1 << (matrixBase + r * colCount + c));
+    }
+
+    return pressed;
+}
+
+/**
+  * Samples and debounces every key, raising events for those that have changed state.
+  *
+  * Each key has a two bit counter (one bit in cnt0, one in cnt1) that counts samples differing
+  * from the debounced state, and resets whenever they agree. The key changes state when the
+  * counter wraps, after four consecutive differing samples.
+  */
+void ATMegaInputScanner::periodicCallback()
+{
+    uint32_t delta = sample() ^ state;
+    uint32_t changed;
+
+    cnt1 = (cnt1 ^ cnt0) & delta;
+    cnt0 = ~cnt0 & delta;
+
+    changed = delta & ~(cnt0 | cnt1);
+    state ^= changed;
+
+    for (int k = 0; changed; k++, changed >>= 1)
+        if (changed & 1)
+            Event(id + k, (state & ((uint32_t)1 << k)) ? DEVICE_BUTTON_EVT_DOWN : DEVICE_BUTTON_EVT_UP);
+}
+
+/**
+  * Determines if the given key is currently pressed, once debounced.
+  *
+  * @param key The key index.
+  *
+  * @return 1 if pressed, 0 if released, or DEVICE_INVALID_PARAMETER if the key does not exist.
+  */
+int ATMegaInputScanner::isPressed(int key)
+{
+    if (key < 0 || key >= keys)
+        return DEVICE_INVALID_PARAMETER;
+
+    return (state & ((uint32_t)1 << key)) ? 1 : 0;
+}
+
+/**
+  * Obtains the debounced state of every key, with bit n set if key n is pressed.
+  */
+uint32_t ATMegaInputScanner::getState()
+{
+    return state;
+}
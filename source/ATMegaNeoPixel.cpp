@@ -0,0 +1,277 @@
+/*
+The MIT License (MIT)
+
+Copyright (c) 2017 Lancaster University.
+
+Permission is hereby granted, free of charge, to any person obtaining a
+copy of this software and associated documentation files (the "Software"),
+to deal in the Software without restriction, including without limitation
+the rights to use, copy, modify, merge, publish, distribute, sublicense,
+and/or sell copies of the Software, and to permit persons to whom the
+Software is furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+DEALINGS IN THE SOFTWARE.
+*/
+
+#include "ATMegaNeoPixel.h"
+#include "ErrorNo.h"
+#include <avr/io.h>
+#include <avr/interrupt.h>
+
+/**
+  * Cycle budget for each bit, for a 1.25us (800kHz) bit period.
+  *
+  * Each bit is sent as:
+  *
+  *     OUT hi, <T0H_PAD nops>, SBRS, OUT lo, <T1H_PAD nops>, OUT lo, <FILL cycles>
+  *
+  * giving T0H = T0H_PAD + 2 cycles, T1H = T0H_PAD + T1H_PAD + 3 cycles and a total of
+  * T0H_PAD + T1H_PAD + FILL + 4 cycles per bit. Loading the next byte and loop control are
+  * hidden in the FILL cycles of particular bits, so FILL must be at least 3.
+  *
+  * Other clocks leave NEOPIXEL_SUPPORTED undefined, so the rest of the port still builds
+  * and send() returns DEVICE_NOT_SUPPORTED.
+  */
+#if !defined(F_CPU)
+#elif (F_CPU == 8000000UL)
+#define NEOPIXEL_T0H_PAD    1       // 375ns
+#define NEOPIXEL_T1H_PAD    2       // 750ns
+#define NEOPIXEL_FILL       3
+#elif (F_CPU == 12000000UL)
+#define NEOPIXEL_T0H_PAD    2       // 333ns
+#define NEOPIXEL_T1H_PAD    4       // 750ns
+#define NEOPIXEL_FILL       5
+#elif (F_CPU == 16000000UL)
+#define NEOPIXEL_T0H_PAD    4       // 375ns
+#define NEOPIXEL_T1H_PAD    6       // 812ns
+#define NEOPIXEL_FILL       6
+#elif (F_CPU == 20000000UL)
+#define NEOPIXEL_T0H_PAD    5       // 350ns
+#define NEOPIXEL_T1H_PAD    8       // 800ns
+#define NEOPIXEL_FILL       8
+#endif
+
+#if ATMEGA_NEOPIXEL_LATCH_US <= ATMEGA_NEOPIXEL_MAX_GAP_US
+#error "ATMEGA_NEOPIXEL_LATCH_US must be longer than ATMEGA_NEOPIXEL_MAX_GAP_US"
+#endif
+
+using namespace codal;
+
+#ifdef NEOPIXEL_T0H_PAD
+#define NEOPIXEL_SUPPORTED
+
+// Timer1 runs at F_CPU / 8.
+#define NEOPIXEL_MAX_GAP_TICKS  ((uint16_t)(ATMEGA_NEOPIXEL_MAX_GAP_US * (F_CPU / 1000UL) / 8000UL))
+#define NEOPIXEL_LATCH_TICKS    ((uint16_t)(ATMEGA_NEOPIXEL_LATCH_US * (F_CPU / 1000UL) / 8000UL))
+
+#define NEOPIXEL_STR2(x)    #x
+#define NEOPIXEL_STR(x)     NEOPIXEL_STR2(x)
+#define NEOPIXEL_NOPS(n)    ".rept " n "\n\tnop\n\t.endr\n\t"
+
+#define NEOPIXEL_BIT(bit, fill)                                 \
+    "out  %[port], %[hi]\n\t"                                   \
+    NEOPIXEL_NOPS(NEOPIXEL_STR(NEOPIXEL_T0H_PAD))               \
+    "sbrs %[byte], " #bit "\n\t"                                \
+    "out  %[port], %[lo]\n\t"                                   \
+    NEOPIXEL_NOPS(NEOPIXEL_STR(NEOPIXEL_T1H_PAD))               \
+    "out  %[port], %[lo]\n\t"                                   \
+    fill
+
+// Send 'count' bytes from 'ptr', MSB first. The byte after the current one is prefetched into
+// 'next' during bit 6, the loop counter decremented during bit 5, and the branch taken in bit 0.
+#define NEOPIXEL_SEND(reg)                                                                      \
+    asm volatile(                                                                               \
+        "1:\n\t"                                                                                \
+        NEOPIXEL_BIT(7, NEOPIXEL_NOPS(NEOPIXEL_STR(NEOPIXEL_FILL)))                             \
+        NEOPIXEL_BIT(6, "ld   %[next], %a[ptr]+\n\t" NEOPIXEL_NOPS(NEOPIXEL_STR(NEOPIXEL_FILL) "-2")) \
+        NEOPIXEL_BIT(5, "dec  %[count]\n\t" NEOPIXEL_NOPS(NEOPIXEL_STR(NEOPIXEL_FILL) "-1"))    \
+        NEOPIXEL_BIT(4, NEOPIXEL_NOPS(NEOPIXEL_STR(NEOPIXEL_FILL)))                             \
+        NEOPIXEL_BIT(3, NEOPIXEL_NOPS(NEOPIXEL_STR(NEOPIXEL_FILL)))                             \
+        NEOPIXEL_BIT(2, NEOPIXEL_NOPS(NEOPIXEL_STR(NEOPIXEL_FILL)))                             \
+        NEOPIXEL_BIT(1, NEOPIXEL_NOPS(NEOPIXEL_STR(NEOPIXEL_FILL)))                             \
+        NEOPIXEL_BIT(0, "mov  %[byte], %[next]\n\t" NEOPIXEL_NOPS(NEOPIXEL_STR(NEOPIXEL_FILL) "-3") "brne 1b\n\t") \
+        : [byte] "+r" (byte), [next] "=&r" (next), [count] "+r" (count), [ptr] "+e" (ptr)      \
+        : [port] "I" (_SFR_IO_ADDR(reg)), [hi] "r" (hi), [lo] "r" (lo)                          \
+    )
+
+/**
+  * Clock the given bytes out of the given port bit. Must be called with interrupts disabled.
+  *
+  * The OUT instruction needs its I/O address at compile time, so a copy of the loop is
+  * generated for each port. The byte following the buffer is read (but not sent) by the prefetch.
+  */
+static void neopixel_send_bytes(uint8_t port, uint8_t mask, const uint8_t *ptr, uint8_t count)
+{
+    uint8_t hi = *PORT_REG[port] | mask;
+    uint8_t lo = *PORT_REG[port] & ~mask;
+    uint8_t byte = *ptr++;
+    uint8_t next;
+
+    switch (port)
+    {
+        case 0:
+            NEOPIXEL_SEND(PORTB);
+            break;
+
+        case 1:
+            NEOPIXEL_SEND(PORTC);
+            break;
+
+        case 2:
+            NEOPIXEL_SEND(PORTD);
+            break;
+    }
+}
+
+/**
+  * Holds the line LO (as it was left by the last pixel) until the latch time has passed since 'end',
+  * so that whatever is sent next starts a new frame.
+  */
+static void neopixel_latch(uint16_t end)
+{
+    uint16_t now;
+
+    do
+    {
+        uint8_t sreg = SREG;
+        cli();
+        now = TCNT1;
+        SREG = sreg;
+    } while ((uint16_t)(now - end) < NEOPIXEL_LATCH_TICKS);
+}
+
+#endif
+
+/**
+  * Constructor.
+  * Create a NeoPixel driver on the given pin, and drive the pin LO.
+  *
+  * @param pin The pin connected to the data input of the strip.
+  */
+ATMegaNeoPixel::ATMegaNeoPixel(ATMegaPin &pin)
+{
+    port = ATMEGA_PIN_PORT(pin.name);
+    mask = ATMEGA_PIN_MASK(pin.name);
+
+    pin.setDigitalValue(0);
+}
+
+/**
+  * Sends a frame one pixel at a time, re-enabling interrupts between pixels.
+  *
+  * If an interrupt holds the line LO for longer than ATMEGA_NEOPIXEL_MAX_GAP_US, the strip
+  * may already have latched a partial frame, so the frame is restarted from the beginning.
+  * The line is held LO for ATMEGA_NEOPIXEL_LATCH_US first, as a gap just short of the strip's
+  * own reset time would otherwise make it treat the restart as a continuation of the old frame.
+  * The same latch time follows every frame, so back to back calls each latch.
+  *
+  * @return DEVICE_OK on success, or DEVICE_BUSY if the final attempt, sent with interrupts disabled,
+  *         still overran the gap between pixels because the generator is too slow.
+  */
+int ATMegaNeoPixel::sendPixels(const uint8_t *buffer, int len, NeoPixelGenerator generator, void *context)
+{
+#ifndef NEOPIXEL_SUPPORTED
+    return DEVICE_NOT_SUPPORTED;
+#else
+    uint8_t pixel[ATMEGA_NEOPIXEL_BYTES_PER_PIXEL + 1];
+    int pixels = generator ? len : (len + ATMEGA_NEOPIXEL_BYTES_PER_PIXEL - 1) / ATMEGA_NEOPIXEL_BYTES_PER_PIXEL;
+
+    for (int attempt = 0; attempt <= ATMEGA_NEOPIXEL_RETRIES; attempt++)
+    {
+        int locked = (attempt == ATMEGA_NEOPIXEL_RETRIES);
+        int complete = 1;
+        uint16_t end = 0;
+        uint8_t sreg = SREG;
+
+        if (locked)
+            cli();
+
+        for (int i = 0; i < pixels; i++)
+        {
+            const uint8_t *data;
+            uint8_t count = ATMEGA_NEOPIXEL_BYTES_PER_PIXEL;
+
+            if (generator)
+            {
+                generator(i, pixel, context);
+                data = pixel;
+            }
+            else
+            {
+                data = buffer + i * ATMEGA_NEOPIXEL_BYTES_PER_PIXEL;
+                if (len - i * ATMEGA_NEOPIXEL_BYTES_PER_PIXEL < count)
+                    count = len - i * ATMEGA_NEOPIXEL_BYTES_PER_PIXEL;
+            }
+
+            cli();
+
+            if (i > 0 && (uint16_t)(TCNT1 - end) > NEOPIXEL_MAX_GAP_TICKS)
+            {
+                complete = 0;
+                break;
+            }
+
+            neopixel_send_bytes(port, mask, data, count);
+            end = TCNT1;
+
+            if (!locked)
+                SREG = sreg;
+        }
+
+        SREG = sreg;
+
+        neopixel_latch(end);
+
+        if (complete)
+            return DEVICE_OK;
+    }
+
+    // Even with interrupts disabled, the generator was too slow: the strip has latched a partial frame.
+    return DEVICE_BUSY;
+#endif
+}
+
+/**
+  * Sends a buffer of pixel data to the strip.
+  *
+  * @param buffer The pixel data, in G, R, B byte order.
+  * @param len The number of bytes to send.
+  *
+  * @return DEVICE_OK on success, DEVICE_INVALID_PARAMETER if buffer is NULL,
+  *         or DEVICE_NOT_SUPPORTED if the driver has no bit timing for F_CPU.
+  */
+int ATMegaNeoPixel::send(const uint8_t *buffer, int len)
+{
+    if (buffer == NULL)
+        return DEVICE_INVALID_PARAMETER;
+
+    return sendPixels(buffer, len, NULL, NULL);
+}
+
+/**
+  * Sends pixels to the strip, generating each one just before it is sent.
+  *
+  * @param generator The function used to generate each pixel.
+  * @param count The number of pixels to send.
+  * @param context An optional pointer handed to the generator.
+  *
+  * @return DEVICE_OK on success, DEVICE_INVALID_PARAMETER if generator is NULL,
+  *         DEVICE_NOT_SUPPORTED if the driver has no bit timing for F_CPU, or DEVICE_BUSY if the
+  *         generator is too slow to keep within ATMEGA_NEOPIXEL_MAX_GAP_US, leaving a partial frame.
+  */
+int ATMegaNeoPixel::send(NeoPixelGenerator generator, int count, void *context)
+{
+    if (generator == NULL)
+        return DEVICE_INVALID_PARAMETER;
+
+    return sendPixels(NULL, count, generator, context);
+}
@@ -0,0 +1,244 @@
+/*
+The MIT License (MIT)
+
+Copyright (c) 2017 Lancaster University.
+
+Permission is hereby granted, free of charge, to any person obtaining a
+copy of this software and associated documentation files (the "Software"),
+to deal in the Software without restriction, including without limitation
+the rights to use, copy, modify, merge, publish, distribute, sublicense,
+and/or sell copies of the Software, and to permit persons to whom the
+Software is furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+DEALINGS IN THE SOFTWARE.
+*/
+
+#include "ATMegaParallelBus.h"
+#include "ErrorNo.h"
+#include <avr/io.h>
+#include <avr/interrupt.h>
+#include <util/delay.h>
+
+using namespace codal;
+
+/**
+  * Constructor.
+  * Create a parallel bus from the given pins.
+  *
+  * @param pins The pins forming the bus, least significant bit first.
+  * @param count The number of pins, at most ATMEGA_PARALLEL_BUS_MAX_WIDTH.
+  */
+ATMegaParallelBus::ATMegaParallelBus(ATMegaPin **pins, int count)
+{
+    uint8_t seen = 0;
+
+    width = count > ATMEGA_PARALLEL_BUS_MAX_WIDTH ? ATMEGA_PARALLEL_BUS_MAX_WIDTH : count;
+
+    // Assume every port can be moved with a single shift, until we find a pin out of sequence.
+    direct = 0xff;
+
+    for (int p = 0; p < ATMEGA_PARALLEL_BUS_PORTS; p++)
+    {
+        mask[p] = 0;
+        shift[p] = 0;
+    }
+
+    for (int i = 0; i < width; i++)
+    {
+        uint8_t name = pins[i]->name;
+        uint8_t port = ATMEGA_PIN_PORT(name);
+        int8_t offset = (int8_t)(name & 0x07) - i;
+
+        this->pins[i] = name;
+        mask[port] |= ATMEGA_PIN_MASK(name);
+
+        if (!(seen & (1 << port)))
+        {
+            shift[port] = offset;
+            seen |= (1 << port);
+        }
+        else if (shift[port] != offset)
+        {
+            direct &= ~(1 << port);
+        }
+    }
+}
+
+/**
+  * Maps a bus value onto the bits of the given port.
+  */
+uint8_t ATMegaParallelBus::toPort(uint16_t value, uint8_t port)
+{
+    uint8_t bits = 0;
+
+    if (direct & (1 << port))
+        return (shift[port] >= 0 ? value << shift[port] : value >> -shift[port]) & mask[port];
+
+    for (int i = 0; i < width; i++)
+        if (ATMEGA_PIN_PORT(pins[i]) == port && (value & (1 << i)))
+            bits |= ATMEGA_PIN_MASK(pins[i]);
+
+    return bits;
+}
+
+/**
+  * Maps the bits sampled from the given port back onto their positions on the bus.
+  */
+uint16_t ATMegaParallelBus::fromPort(uint8_t bits, uint8_t port)
+{
+    uint16_t value = 0;
+
+    bits &= mask[port];
+
+    if (direct & (1 << port))
+        return shift[port] >= 0 ? bits >> shift[port] : (uint16_t)bits << -shift[port];
+
+    for (int i = 0; i < width; i++)
+        if (ATMEGA_PIN_PORT(pins[i]) == port && (bits & ATMEGA_PIN_MASK(pins[i])))
+            value |= (1 << i);
+
+    return value;
+}
+
+/**
+  * Configures every pin on the bus as a digital output.
+  *
+  * @return DEVICE_OK on success.
+  */
+int ATMegaParallelBus::setOutput()
+{
+    uint8_t sreg = SREG;
+    cli();
+
+    for (int p = 0; p < ATMEGA_PARALLEL_BUS_PORTS; p++)
+        *DD_REG[p] |= mask[p];
+
+    SREG = sreg;
+
+    return DEVICE_OK;
+}
+
+/**
+  * Configures every pin on the bus as a digital input.
+  *
+  * @param pullUp true to enable the internal pull up resistors.
+  *
+  * @return DEVICE_OK on success.
+  */
+int ATMegaParallelBus::setInput(bool pullUp)
+{
+    uint8_t sreg = SREG;
+    cli();
+
+    for (int p = 0; p < ATMEGA_PARALLEL_BUS_PORTS; p++)
+    {
+        *DD_REG[p] &= ~mask[p];
+
+        if (pullUp)
+            *PORT_REG[p] |= mask[p];
+        else
+            *PORT_REG[p] &= ~mask[p];
+    }
+
+    SREG = sreg;
+
+    return DEVICE_OK;
+}
+
+/**
+  * Drives the given value onto the bus.
+  *
+  * @param value The value to write. Bits beyond the width of the bus are ignored.
+  *
+  * @return DEVICE_OK on success.
+  */
+int ATMegaParallelBus::write(uint16_t value)
+{
+    uint8_t bits[ATMEGA_PARALLEL_BUS_PORTS];
+
+    // Compute the new port contents up front, to keep the time spent with interrupts disabled short.
+    for (int p = 0; p < ATMEGA_PARALLEL_BUS_PORTS; p++)
+        bits[p] = toPort(value, p);
+
+    uint8_t sreg = SREG;
+    cli();
+
+    for (int p = 0; p < ATMEGA_PARALLEL_BUS_PORTS; p++)
+        if (mask[p])
+            *PORT_REG[p] = (*PORT_REG[p] & ~mask[p]) | bits[p];
+
+    SREG = sreg;
+
+    return DEVICE_OK;
+}
+
+/**
+  * Samples every pin on the bus.
+  *
+  * @return the value on the bus.
+  */
+uint16_t ATMegaParallelBus::read()
+{
+    uint8_t bits[ATMEGA_PARALLEL_BUS_PORTS];
+    uint16_t value = 0;
+
+    // Sample every port back to back before decoding, so the snapshot is as coherent as possible.
+    uint8_t sreg = SREG;
+    cli();
+
+    for (int p = 0; p < ATMEGA_PARALLEL_BUS_PORTS; p++)
+        bits[p] = *PIN_REG[p];
+
+    SREG = sreg;
+
+    for (int p = 0; p < ATMEGA_PARALLEL_BUS_PORTS; p++)
+        if (mask[p])
+            value |= fromPort(bits[p], p);
+
+    return value;
+}
+
+/**
+  * Writes a sequence of bytes onto the bus, pulsing the given strobe pin after each one.
+  *
+  * @param buffer The bytes to write.
+  * @param len The number of bytes to write.
+  * @param strobePin An output pin used to latch each byte.
+  *
+  * @return DEVICE_OK on success, or DEVICE_INVALID_PARAMETER if buffer is NULL.
+  */
+int ATMegaParallelBus::writeBlock(const uint8_t *buffer, int len, ATMegaPin &strobePin)
+{
+    if (buffer == NULL)
+        return DEVICE_INVALID_PARAMETER;
+
+    volatile uint8_t *strobe = PIN_REG[ATMEGA_PIN_PORT(strobePin.name)];
+    uint8_t strobeMask = ATMEGA_PIN_MASK(strobePin.name);
+
+    while (len--)
+    {
+        write(*buffer++);
+
+#if ATMEGA_PARALLEL_BUS_SETUP_NS > 0
+        _delay_us(ATMEGA_PARALLEL_BUS_SETUP_NS / 1000.0);
+#endif
+
+        // Writing a one to PINx toggles the output, so two writes give a pulse of either polarity.
+        *strobe = strobeMask;
+#if ATMEGA_PARALLEL_BUS_STROBE_NS > 0
+        _delay_us(ATMEGA_PARALLEL_BUS_STROBE_NS / 1000.0);
+#endif
+        *strobe = strobeMask;
+    }
+
+    return DEVICE_OK;
+}
@@ -34,9 +34,9 @@ DEALINGS IN THE SOFTWARE.
 #include "Event.h"
 #include <avr/io.h>
 
-static volatile uint8_t* const DD_REG[] = {&DDRB, &DDRC, &DDRD};
-static volatile uint8_t* const PORT_REG[] = {&PORTB, &PORTC, &PORTD};
-static volatile uint8_t* const PIN_REG[] = {&PINB, &PINC, &PIND};
+volatile uint8_t* const DD_REG[] = {&DDRB, &DDRC, &DDRD};
+volatile uint8_t* const PORT_REG[] = {&PORTB, &PORTC, &PORTD};
+volatile uint8_t* const PIN_REG[] = {&PINB, &PINC, &PIND};
 
 using namespace codal;
 
@@ -72,7 +72,7 @@ ATMegaPin::ATMegaPin(PinNumber name, PinCapability capability) : Pin(DEVICE_ID_I
 
     if (!portsInitialized)
     {
-        // Configure for a 125khz ADC clock, usung Vcc as a reference and free running mode.
+        // Configure for a 125khz ADC clock, usung Vcc as a reference and single conversions.
         ADCSRA = (1 << ADPS2) | (1 << ADPS1) | (1 << ADPS0);
         ADCSRB = 0;
 
@@ -191,8 +191,9 @@ int ATMegaPin::getDigitalValue()
 /**
   * Configures this IO pin as an analogue input (if necessary), and samples the Pin for its analog value.
   *
-  * @return the current analogue level on the pin, in the range 0 - 1024, or
-  *         DEVICE_NOT_SUPPORTED if the given pin does not have analog capability.
+  * @return the current analogue level on the pin, in the range 0 - 1024, DEVICE_NOT_SUPPORTED
+  *         if the given pin does not have analog capability, or DEVICE_BUSY if an ATMegaADCStream
+  *         is running.
   *
   * @code
   * Pin P0(DEVICE_ID_IO_P0, DEVICE_PIN_P0, PIN_CAPABILITY_BOTH);
@@ -208,16 +209,40 @@ int ATMegaPin::getAnalogValue()
     // Move into an analogue input state if necessary.
     if (!(status & IO_STATUS_ANALOG_IN)){
         disconnect();
-        ADMUX = (1 << REFS0) | (name & 0x07);
-        ADCSRA |= ((1 << ADEN) | (1 << ADSC));
+        IOREG_CLR(DD_REG);
+        IOREG_CLR(PORT_REG);
         status |= IO_STATUS_ANALOG_IN;
     }
 
-    // Perform a blocking read.
-    while((ADCSRA & (1 << ADIF)) == 0);
-    ADCSRA |= (1 << ADIF);
+    return sampleAnalog(name & 0x07);
+}
+
+/**
+  * Performs a single blocking conversion on the given ADC channel, with a 125khz ADC clock.
+  * Shared by every analog read, which must first configure its pin as an analog input.
+  *
+  * @param channel The ADC channel, 0 - 7.
+  *
+  * @return the level on the channel, in the range 0 - 1023, or DEVICE_BUSY if an
+  *         ATMegaADCStream is running.
+  */
+int ATMegaPin::sampleAnalog(uint8_t channel)
+{
+    // A running ATMegaADCStream owns the multiplexer and the conversion interrupt.
+    if (ADCSRA & ((1 << ADATE) | (1 << ADIE)))
+        return DEVICE_BUSY;
+
+    // The multiplexer is shared by every analog pin, so always select this one. Auto triggering
+    // is off, so each read starts its own conversion. The prescaler is set here too, as the
+    // pin table can read before any ATMegaPin has been constructed.
+    ADMUX = (1 << REFS0) | channel;
+    ADCSRA = (1 << ADEN) | (1 << ADSC) | (1 << ADIF) | (1 << ADPS2) | (1 << ADPS1) | (1 << ADPS0);
+
+    while (ADCSRA & (1 << ADSC));
 
-    return (uint16_t)ADCH << 8 | ADCL;
+    // ADCL must be read first.
+    uint8_t low = ADCL;
+    return (uint16_t)ADCH << 8 | low;
 }
 
 /**
@@ -0,0 +1,291 @@
+/*
+The MIT License (MIT)
+
+Copyright (c) 2017 Lancaster University.
+
+Permission is hereby granted, free of charge, to any person obtaining a
+copy of this software and associated documentation files (the "Software"),
+to deal in the Software without restriction, including without limitation
+the rights to use, copy, modify, merge, publish, distribute, sublicense,
+and/or sell copies of the Software, and to permit persons to whom the
+Software is furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+DEALINGS IN THE SOFTWARE.
+*/
+
+#include "ATMegaPinTable.h"
+#include "ErrorNo.h"
+#include <avr/io.h>
+#include <avr/pgmspace.h>
+
+using namespace codal;
+
+// Capabilities of each pin, indexed by PinNumber. PB6/PB7 carry the crystal, PC6 is RESET and PC7 does not exist.
+static const uint8_t CAPABILITY[ATMEGA_PIN_TABLE_SIZE] PROGMEM =
+{
+    PIN_CAPABILITY_DIGITAL, PIN_CAPABILITY_DIGITAL, PIN_CAPABILITY_DIGITAL, PIN_CAPABILITY_DIGITAL,
+    PIN_CAPABILITY_DIGITAL, PIN_CAPABILITY_DIGITAL, 0, 0,
+
+    PIN_CAPABILITY_AD, PIN_CAPABILITY_AD, PIN_CAPABILITY_AD, PIN_CAPABILITY_AD,
+    PIN_CAPABILITY_AD, PIN_CAPABILITY_AD, 0, 0,
+
+    PIN_CAPABILITY_DIGITAL, PIN_CAPABILITY_DIGITAL, PIN_CAPABILITY_DIGITAL, PIN_CAPABILITY_DIGITAL,
+    PIN_CAPABILITY_DIGITAL, PIN_CAPABILITY_DIGITAL, PIN_CAPABILITY_DIGITAL, PIN_CAPABILITY_DIGITAL
+};
+
+// Two bits of mode per pin.
+static uint8_t modes[ATMEGA_PIN_TABLE_SIZE / 4];
+
+// One bit per pin, set if a pull up is configured. PORTx cannot hold it while the pin is an output.
+static uint8_t pulls[ATMEGA_PIN_TABLE_SIZE / 8];
+
+static ATMegaPin *cache[ATMEGA_PIN_TABLE_CACHE_SIZE];
+
+static uint8_t getMode(PinNumber name)
+{
+    return (modes[name >> 2] >> ((name & 0x03) << 1)) & ATMEGA_PIN_TABLE_MODE_MASK;
+}
+
+static void setMode(PinNumber name, uint8_t mode)
+{
+    uint8_t shift = (name & 0x03) << 1;
+    modes[name >> 2] = (modes[name >> 2] & ~(ATMEGA_PIN_TABLE_MODE_MASK << shift)) | (mode << shift);
+}
+
+static bool getPull(PinNumber name)
+{
+    return pulls[name >> 3] & (1 << (name & 0x07));
+}
+
+static void setPullBit(PinNumber name, bool up)
+{
+    if (up)
+        pulls[name >> 3] |= (1 << (name & 0x07));
+    else
+        pulls[name >> 3] &= ~(1 << (name & 0x07));
+}
+
+static ATMegaPin *lookup(PinNumber name)
+{
+    for (int i = 0; i < ATMEGA_PIN_TABLE_CACHE_SIZE; i++)
+        if (cache[i] && cache[i]->name == name)
+            return cache[i];
+
+    return NULL;
+}
+
+/**
+  * Determines the capabilities of the given pin.
+  *
+  * @param name The pin.
+  *
+  * @return The pin's capabilities, or 0 if it is not available as an I/O pin.
+  */
+PinCapability ATMegaPinTable::getCapability(PinNumber name)
+{
+    if (name >= ATMEGA_PIN_TABLE_SIZE)
+        return (PinCapability)0;
+
+    return (PinCapability)pgm_read_byte(&CAPABILITY[name]);
+}
+
+/**
+  * Obtains an ATMegaPin for the given pin, creating it if necessary.
+  *
+  * @param name The pin.
+  *
+  * @return The pin object, or NULL if the pin is not available or the cache is full.
+  */
+ATMegaPin *ATMegaPinTable::get(PinNumber name)
+{
+    PinCapability capability = getCapability(name);
+
+    if (capability == 0)
+        return NULL;
+
+    ATMegaPin *pin = lookup(name);
+
+    if (pin)
+        return pin;
+
+    for (int i = 0; i < ATMEGA_PIN_TABLE_CACHE_SIZE; i++)
+    {
+        if (cache[i] == NULL)
+        {
+            pin = new ATMegaPin(name, capability);
+            uint8_t mask = ATMEGA_PIN_MASK(name);
+
+            // Seed the new object from the state held in the table and the port registers.
+            // The pull is set before the status, so the object does not write it to the hardware.
+            if (getPull(name))
+                pin->setPull(PullMode::Up);
+
+            if (getMode(name) == ATMEGA_PIN_TABLE_MODE_ANALOG_IN)
+            {
+                pin->status |= IO_STATUS_ANALOG_IN;
+            }
+            else if (*DD_REG[ATMEGA_PIN_PORT(name)] & mask)
+            {
+                pin->status |= IO_STATUS_DIGITAL_OUT;
+            }
+            else if (*PORT_REG[ATMEGA_PIN_PORT(name)] & mask)
+            {
+                pin->setPull(PullMode::Up);
+                pin->status |= IO_STATUS_DIGITAL_IN;
+            }
+
+            cache[i] = pin;
+            return pin;
+        }
+    }
+
+    return NULL;
+}
+
+/**
+  * Configures the given pin as a digital output (if necessary) and sets its value.
+  *
+  * @param name The pin.
+  * @param value 0 (LO) or 1 (HI)
+  *
+  * @return DEVICE_OK on success, DEVICE_INVALID_PARAMETER if value is out of range, or DEVICE_NOT_SUPPORTED
+  *         if the given pin does not have digital capability.
+  */
+int ATMegaPinTable::setDigitalValue(PinNumber name, int value)
+{
+    if (!(getCapability(name) & PIN_CAPABILITY_DIGITAL))
+        return DEVICE_NOT_SUPPORTED;
+
+    ATMegaPin *pin = lookup(name);
+    if (pin)
+        return pin->setDigitalValue(value);
+
+    if (value < 0)
+        return DEVICE_INVALID_PARAMETER;
+
+    uint8_t port = ATMEGA_PIN_PORT(name);
+    uint8_t mask = ATMEGA_PIN_MASK(name);
+
+    // Set the level before the direction, so the pin does not glitch.
+    if (value)
+        *PORT_REG[port] |= mask;
+    else
+        *PORT_REG[port] &= ~mask;
+
+    *DD_REG[port] |= mask;
+    setMode(name, ATMEGA_PIN_TABLE_MODE_DIGITAL);
+
+    return DEVICE_OK;
+}
+
+/**
+  * Configures the given pin as a digital input (if necessary) and tests its current value.
+  *
+  * @param name The pin.
+  *
+  * @return 1 if this input is high, 0 if input is LO, or DEVICE_NOT_SUPPORTED
+  *         if the given pin does not have digital capability.
+  */
+int ATMegaPinTable::getDigitalValue(PinNumber name)
+{
+    if (!(getCapability(name) & PIN_CAPABILITY_DIGITAL))
+        return DEVICE_NOT_SUPPORTED;
+
+    ATMegaPin *pin = lookup(name);
+    if (pin)
+        return pin->getDigitalValue();
+
+    uint8_t port = ATMEGA_PIN_PORT(name);
+    uint8_t mask = ATMEGA_PIN_MASK(name);
+
+    // Move into a digital input state if necessary, applying the configured pull as ATMegaPin does.
+    // A pin that is already an input holds its pull in PORTx.
+    if ((*DD_REG[port] & mask) || getMode(name) != ATMEGA_PIN_TABLE_MODE_DIGITAL)
+    {
+        *DD_REG[port] &= ~mask;
+
+        if (getPull(name))
+            *PORT_REG[port] |= mask;
+        else
+            *PORT_REG[port] &= ~mask;
+
+        setMode(name, ATMEGA_PIN_TABLE_MODE_DIGITAL);
+    }
+
+    return (*PIN_REG[port] & mask) ? 1 : 0;
+}
+
+/**
+  * Configures the pull of the given pin. Pull downs are not supported by the hardware,
+  * and are treated as PullMode::None.
+  *
+  * @param name The pin.
+  * @param pull one of the mbed pull configurations: PullUp, PullDown, PullNone
+  *
+  * @return DEVICE_OK on success, or DEVICE_NOT_SUPPORTED if the given pin does not have digital capability.
+  */
+int ATMegaPinTable::setPull(PinNumber name, PullMode pull)
+{
+    if (!(getCapability(name) & PIN_CAPABILITY_DIGITAL))
+        return DEVICE_NOT_SUPPORTED;
+
+    ATMegaPin *pin = lookup(name);
+    if (pin)
+        return pin->setPull(pull);
+
+    uint8_t port = ATMEGA_PIN_PORT(name);
+    uint8_t mask = ATMEGA_PIN_MASK(name);
+
+    setPullBit(name, pull == PullMode::Up);
+
+    // For an input, PORTx is the pull up. For an output, it is the level, and must be left alone
+    // until the pin next becomes an input.
+    if ((*DD_REG[port] & mask) || getMode(name) != ATMEGA_PIN_TABLE_MODE_DIGITAL)
+        return DEVICE_OK;
+
+    if (pull == PullMode::Up)
+        *PORT_REG[port] |= mask;
+    else
+        *PORT_REG[port] &= ~mask;
+
+    return DEVICE_OK;
+}
+
+/**
+  * Configures the given pin as an analogue input (if necessary), and samples it.
+  *
+  * @param name The pin.
+  *
+  * @return the current analogue level on the pin, in the range 0 - 1023, DEVICE_NOT_SUPPORTED
+  *         if the given pin does not have analog capability, or DEVICE_BUSY if an ATMegaADCStream
+  *         is running.
+  */
+int ATMegaPinTable::getAnalogValue(PinNumber name)
+{
+    if (!(getCapability(name) & PIN_CAPABILITY_ANALOG))
+        return DEVICE_NOT_SUPPORTED;
+
+    ATMegaPin *pin = lookup(name);
+    if (pin)
+        return pin->getAnalogValue();
+
+    if (getMode(name) != ATMEGA_PIN_TABLE_MODE_ANALOG_IN)
+    {
+        uint8_t mask = ATMEGA_PIN_MASK(name);
+
+        *DD_REG[ATMEGA_PIN_PORT(name)] &= ~mask;
+        *PORT_REG[ATMEGA_PIN_PORT(name)] &= ~mask;
+        setMode(name, ATMEGA_PIN_TABLE_MODE_ANALOG_IN);
+    }
+
+    return ATMegaPin::sampleAnalog(name & 0x07);
+}
@@ -0,0 +1,190 @@
+/*
+The MIT License (MIT)
+
+Copyright (c) 2017 Lancaster University.
+
+Permission is hereby granted, free of charge, to any person obtaining a
+copy of this software and associated documentation files (the "Software"),
+to deal in the Software without restriction, including without limitation
+the rights to use, copy, modify, merge, publish, distribute, sublicense,
+and/or sell copies of the Software, and to permit persons to whom the
+Software is furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+DEALINGS IN THE SOFTWARE.
+*/
+
+#include "ATMegaPreemption.h"
+#include "CodalFiber.h"
+#include "ErrorNo.h"
+#include <avr/io.h>
+#include <avr/interrupt.h>
+
+using namespace codal;
+
+static uint16_t slice = 0;                  // Time slice in Timer1 ticks (0.5us), or 0 if disabled.
+static volatile uint8_t preemptible = 0;    // Nesting depth of preemptible regions in the running fiber.
+static volatile uint8_t locked = 0;         // Nesting depth of the preemption lock.
+static volatile uint8_t pending = 0;        // A time slice expired whilst the lock was held.
+static volatile uint16_t preemptions = 0;
+
+/**
+  * Starts preemptive time slicing. Timer1 must already be running as the system timer.
+  *
+  * @param sliceUs The time slice in microseconds, at most ATMEGA_PREEMPTION_MAX_SLICE_US.
+  *
+  * @return DEVICE_OK on success, or DEVICE_INVALID_PARAMETER if the time slice is out of range.
+  */
+int codal::fiber_preemption_enable(uint16_t sliceUs)
+{
+    if (sliceUs == 0 || sliceUs > ATMEGA_PREEMPTION_MAX_SLICE_US)
+        return DEVICE_INVALID_PARAMETER;
+
+    uint8_t sreg = SREG;
+    cli();
+
+    slice = sliceUs << 1;
+    OCR1B = TCNT1 + slice;
+    TIFR1 = (1 << OCF1B);
+    TIMSK1 |= (1 << OCIE1B);
+
+    SREG = sreg;
+
+    return DEVICE_OK;
+}
+
+/**
+  * Stops preemptive time slicing.
+  */
+void codal::fiber_preemption_disable()
+{
+    uint8_t sreg = SREG;
+    cli();
+
+    TIMSK1 &= ~(1 << OCIE1B);
+    slice = 0;
+    pending = 0;
+
+    SREG = sreg;
+}
+
+/**
+  * Marks the start of a region in which the calling fiber may be preempted.
+  */
+void codal::fiber_preemptible_begin()
+{
+    uint8_t sreg = SREG;
+    cli();
+    preemptible++;
+    SREG = sreg;
+}
+
+/**
+  * Marks the end of a preemptible region.
+  */
+void codal::fiber_preemptible_end()
+{
+    uint8_t sreg = SREG;
+    cli();
+    if (preemptible)
+        preemptible--;
+    SREG = sreg;
+}
+
+/**
+  * Prevents preemption until the matching fiber_preemption_unlock(). Calls may be nested.
+  * Take the lock around allocation and shared state within a preemptible region. The calling
+  * fiber must not block while holding the lock.
+  */
+void codal::fiber_preemption_lock()
+{
+    uint8_t sreg = SREG;
+    cli();
+    locked++;
+    SREG = sreg;
+}
+
+/**
+  * Releases the preemption lock. If a time slice expired whilst it was held, the calling
+  * fiber yields immediately.
+  */
+void codal::fiber_preemption_unlock()
+{
+    uint8_t sreg = SREG;
+    cli();
+
+    bool yield = false;
+
+    if (locked && --locked == 0 && pending)
+    {
+        pending = 0;
+        yield = preemptible != 0;
+    }
+
+    SREG = sreg;
+
+    // We are in fiber context with the lock free, so this is an ordinary cooperative yield.
+    if (yield)
+    {
+        uint8_t saved = preemptible;
+        preemptible = 0;
+        schedule();
+        preemptible = saved;
+    }
+}
+
+/**
+  * Determines the number of times a fiber has been preempted.
+  */
+uint16_t codal::fiber_preemption_count()
+{
+    uint8_t sreg = SREG;
+    cli();
+    uint16_t count = preemptions;
+    SREG = sreg;
+
+    return count;
+}
+
+/**
+  * Time slice interrupt.
+  *
+  * As this calls an external function, the compiler saves SREG, r0, r1, r18-r27 and r30-r31 on entry.
+  * The remaining registers are preserved across schedule() by the calling convention and swap_context.
+  */
+ISR(TIMER1_COMPB_vect)
+{
+    OCR1B += slice;
+
+    if (!preemptible || !fiber_scheduler_running())
+        return;
+
+    if (locked)
+    {
+        pending = 1;
+        return;
+    }
+
+    // The fiber we switch to runs cooperatively, whatever region the preempted one was in.
+    // Its own depth is restored when it is resumed here.
+    uint8_t saved = preemptible;
+    preemptible = 0;
+    preemptions++;
+
+    // The next fiber may have yielded cooperatively, so it must resume with interrupts enabled.
+    // schedule() may resize the fiber's stack buffer from here, which is why a fiber holding the
+    // lock, and so possibly inside the heap, is never preempted.
+    sei();
+    schedule();
+    cli();
+
+    preemptible = saved;
+}
@@ -0,0 +1,335 @@
+/*
+The MIT License (MIT)
+
+Copyright (c) 2017 Lancaster University.
+
+Permission is hereby granted, free of charge, to any person obtaining a
+copy of this software and associated documentation files (the "Software"),
+to deal in the Software without restriction, including without limitation
+the rights to use, copy, modify, merge, publish, distribute, sublicense,
+and/or sell copies of the Software, and to permit persons to whom the
+Software is furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+DEALINGS IN THE SOFTWARE.
+*/
+
+#include "ATMegaPulseIn.h"
+#include "ErrorNo.h"
+#include "Event.h"
+#include <avr/io.h>
+#include <avr/interrupt.h>
+
+using namespace codal;
+
+static volatile uint8_t* const PCMSK_REG[] = {&PCMSK0, &PCMSK1, &PCMSK2};
+
+static ATMegaPulseIn *icp1Channel = NULL;
+
+static ATMegaPulseIn *channels[ATMEGA_PULSE_IN_MAX_CHANNELS];
+static uint8_t channelPort[ATMEGA_PULSE_IN_MAX_CHANNELS];
+static uint8_t channelMask[ATMEGA_PULSE_IN_MAX_CHANNELS];
+static uint8_t lastPortState[3];
+
+ISR(TIMER1_CAPT_vect)
+{
+    uint16_t timestamp = ICR1;
+    uint8_t rising = TCCR1B & (1 << ICES1);
+
+    // Look for the opposite edge next. The capture flag must be cleared after changing edge.
+    TCCR1B ^= (1 << ICES1);
+    TIFR1 = (1 << ICF1);
+
+    if (icp1Channel)
+        icp1Channel->onEdge(rising, timestamp);
+}
+
+/**
+  * Common pin change handler. Timestamps the change, then dispatches it to any channels on the given port.
+  */
+static inline void pulse_in_pin_change(uint8_t port)
+{
+    uint16_t timestamp = TCNT1;
+    uint8_t state = *PIN_REG[port];
+    uint8_t changed = state ^ lastPortState[port];
+
+    lastPortState[port] = state;
+
+    for (int i = 0; i < ATMEGA_PULSE_IN_MAX_CHANNELS; i++)
+        if (channels[i] && channelPort[i] == port && (changed & channelMask[i]))
+            channels[i]->onEdge(state & channelMask[i], timestamp);
+}
+
+ISR(PCINT0_vect)
+{
+    pulse_in_pin_change(0);
+}
+
+ISR(PCINT1_vect)
+{
+    pulse_in_pin_change(1);
+}
+
+ISR(PCINT2_vect)
+{
+    pulse_in_pin_change(2);
+}
+
+/**
+  * Constructor.
+  * Create a pulse meter on the given pin. Measurement does not begin until enable() is called.
+  *
+  * @param pin The pin to measure. Timestamps are exact if this is ATMEGA_PULSE_IN_ICP1.
+  */
+ATMegaPulseIn::ATMegaPulseIn(ATMegaPin &pin) : pin(pin)
+{
+    this->id = pin.id;
+    this->status = 0;
+
+    lastRise = 0;
+    lastFall = 0;
+    head = 0;
+    tail = 0;
+    overruns = 0;
+}
+
+/**
+  * Configures the pin as a digital input and starts timestamping its edges.
+  *
+  * @return DEVICE_OK on success, or DEVICE_NO_RESOURCES if all pin change channels are in use.
+  */
+int ATMegaPulseIn::enable()
+{
+    if (status & ATMEGA_PULSE_IN_STATUS_ENABLED)
+        return DEVICE_OK;
+
+    // Move into a digital input state (applying any pull), and sample the current level.
+    int high = pin.getDigitalValue();
+    if (high < 0)
+        return high;
+
+    uint8_t sreg = SREG;
+    cli();
+
+    status &= ~(ATMEGA_PULSE_IN_STATUS_HAVE_RISE | ATMEGA_PULSE_IN_STATUS_HAVE_FALL);
+
+    if (pin.name == ATMEGA_PULSE_IN_ICP1)
+    {
+        if (icp1Channel)
+        {
+            SREG = sreg;
+            return DEVICE_NO_RESOURCES;
+        }
+
+        icp1Channel = this;
+
+        // Capture on the next edge the pin can make, with the noise canceller enabled.
+        if (high)
+            TCCR1B &= ~(1 << ICES1);
+        else
+            TCCR1B |= (1 << ICES1);
+
+        TCCR1B |= (1 << ICNC1);
+        TIFR1 = (1 << ICF1);
+        TIMSK1 |= (1 << ICIE1);
+    }
+    else
+    {
+        int i;
+        uint8_t port = ATMEGA_PIN_PORT(pin.name);
+        uint8_t mask = ATMEGA_PIN_MASK(pin.name);
+
+        for (i = 0; i < ATMEGA_PULSE_IN_MAX_CHANNELS; i++)
+            if (channels[i] == NULL)
+                break;
+
+        if (i == ATMEGA_PULSE_IN_MAX_CHANNELS)
+        {
+            SREG = sreg;
+            return DEVICE_NO_RESOURCES;
+        }
+
+        channels[i] = this;
+        channelPort[i] = port;
+        channelMask[i] = mask;
+
+        // Only refresh our own bit, so pending changes on other channels of this port are not lost.
+        lastPortState[port] = (lastPortState[port] & ~mask) | (*PIN_REG[port] & mask);
+
+        *PCMSK_REG[port] |= mask;
+        PCICR |= (1 << port);
+    }
+
+    status |= ATMEGA_PULSE_IN_STATUS_ENABLED;
+    pin.status |= IO_STATUS_EVENT_PULSE_ON_EDGE;
+
+    SREG = sreg;
+
+    return DEVICE_OK;
+}
+
+/**
+  * Stops timestamping edges on the pin.
+  *
+  * @return DEVICE_OK on success.
+  */
+int ATMegaPulseIn::disable()
+{
+    if (!(status & ATMEGA_PULSE_IN_STATUS_ENABLED))
+        return DEVICE_OK;
+
+    uint8_t sreg = SREG;
+    cli();
+
+    if (icp1Channel == this)
+    {
+        TIMSK1 &= ~(1 << ICIE1);
+        icp1Channel = NULL;
+    }
+
+    for (int i = 0; i < ATMEGA_PULSE_IN_MAX_CHANNELS; i++)
+    {
+        if (channels[i] == this)
+        {
+            uint8_t port = channelPort[i];
+            channels[i] = NULL;
+
+            *PCMSK_REG[port] &= ~channelMask[i];
+            if (*PCMSK_REG[port] == 0)
+                PCICR &= ~(1 << port);
+        }
+    }
+
+    status &= ~ATMEGA_PULSE_IN_STATUS_ENABLED;
+    pin.status &= ~IO_STATUS_EVENT_PULSE_ON_EDGE;
+
+    SREG = sreg;
+
+    return DEVICE_OK;
+}
+
+/**
+  * Determines if measurements are also raised as events on the message bus.
+  *
+  * @param enabled true to raise DEVICE_PIN_EVT_PULSE_HI / DEVICE_PIN_EVT_PULSE_LO events.
+  */
+void ATMegaPulseIn::setEventsEnabled(bool enabled)
+{
+    if (enabled)
+        status |= ATMEGA_PULSE_IN_STATUS_EVENTS;
+    else
+        status &= ~ATMEGA_PULSE_IN_STATUS_EVENTS;
+}
+
+/**
+  * Determines the number of completed measurements waiting to be read.
+  */
+int ATMegaPulseIn::available()
+{
+    return (head - tail) & (ATMEGA_PULSE_IN_BUFFER_SIZE - 1);
+}
+
+/**
+  * Removes the oldest completed measurement from the buffer.
+  *
+  * @param m The structure to populate.
+  *
+  * @return DEVICE_OK on success, or DEVICE_NO_DATA if the buffer is empty.
+  */
+int ATMegaPulseIn::read(PulseMeasurement &m)
+{
+    uint8_t t = tail;
+
+    if (t == head)
+        return DEVICE_NO_DATA;
+
+    uint8_t sreg = SREG;
+    cli();
+    m = buffer[t];
+    SREG = sreg;
+
+    tail = (t + 1) & (ATMEGA_PULSE_IN_BUFFER_SIZE - 1);
+
+    return DEVICE_OK;
+}
+
+/**
+  * Determines the number of measurements discarded because the buffer was full.
+  */
+uint16_t ATMegaPulseIn::getOverruns()
+{
+    uint8_t sreg = SREG;
+    cli();
+    uint16_t o = overruns;
+    SREG = sreg;
+
+    return o;
+}
+
+/**
+  * Records an edge on the pin. Called from interrupt context.
+  *
+  * A measurement is completed on each rising edge that follows a full HI pulse.
+  *
+  * @param rising non-zero if the pin is now HI.
+  * @param timestamp The Timer1 count at which the edge occurred.
+  */
+void ATMegaPulseIn::onEdge(uint8_t rising, uint16_t timestamp)
+{
+    if (rising)
+    {
+        if (status & ATMEGA_PULSE_IN_STATUS_HAVE_FALL)
+        {
+            uint8_t next = (head + 1) & (ATMEGA_PULSE_IN_BUFFER_SIZE - 1);
+
+            if (next == tail)
+            {
+                overruns++;
+            }
+            else
+            {
+                buffer[head].width = lastFall - lastRise;
+                buffer[head].period = timestamp - lastRise;
+                head = next;
+            }
+
+            if (status & ATMEGA_PULSE_IN_STATUS_EVENTS)
+            {
+                Event evt(id, DEVICE_PIN_EVT_PULSE_LO, CREATE_ONLY);
+                evt.timestamp = (uint16_t)(timestamp - lastFall) >> 1;
+                evt.fire();
+            }
+        }
+
+        lastRise = timestamp;
+        status = (status & ~ATMEGA_PULSE_IN_STATUS_HAVE_FALL) | ATMEGA_PULSE_IN_STATUS_HAVE_RISE;
+    }
+    else if (status & ATMEGA_PULSE_IN_STATUS_HAVE_RISE)
+    {
+        lastFall = timestamp;
+        status |= ATMEGA_PULSE_IN_STATUS_HAVE_FALL;
+
+        if (status & ATMEGA_PULSE_IN_STATUS_EVENTS)
+        {
+            Event evt(id, DEVICE_PIN_EVT_PULSE_HI, CREATE_ONLY);
+            evt.timestamp = (uint16_t)(lastFall - lastRise) >> 1;
+            evt.fire();
+        }
+    }
+}
+
+/**
+  * Destructor. Stops any measurement in progress.
+  */
+ATMegaPulseIn::~ATMegaPulseIn()
+{
+    disable();
+}
@@ -0,0 +1,255 @@
+/*
+The MIT License (MIT)
+
+Copyright (c) 2017 Lancaster University.
+
+Permission is hereby granted, free of charge, to any person obtaining a
+copy of this software and associated documentation files (the "Software"),
+to deal in the Software without restriction, including without limitation
+the rights to use, copy, modify, merge, publish, distribute, sublicense,
+and/or sell copies of the Software, and to permit persons to whom the
+Software is furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+DEALINGS IN THE SOFTWARE.
+*/
+
+#include "ATMegaSPI.h"
+#include "ErrorNo.h"
+#include "avr/io.h"
+#include "avr/interrupt.h"
+
+#define SPI_DONE (SPSR & (1 << SPIF))
+#define SPI_BUSY (SPCR & (1 << SPIE))
+
+#define SPI_FILL_BYTE 0xFF
+
+static codal::ATMegaSPI *instance = NULL;
+
+ISR(SPI_STC_vect)
+{
+    if (instance)
+        instance->irq();
+}
+
+namespace codal
+{
+
+/**
+  * Constructor.
+  * Configures the SPI peripheral as a master in mode 0 at 1MHz.
+  *
+  * @param mosi The MOSI pin (PB3).
+  * @param miso The MISO pin (PB4).
+  * @param sclk The SCK pin (PB5).
+  */
+ATMegaSPI::ATMegaSPI(ATMegaPin &mosi, ATMegaPin &miso, ATMegaPin &sclk)
+{
+    index = 0;
+    length = 0;
+    doneHandler = NULL;
+
+    mosi.setDigitalValue(0);
+    sclk.setDigitalValue(0);
+    miso.getDigitalValue();
+
+    // SS must not be allowed to float LO, or the peripheral will switch to slave mode.
+    DDRB |= (1 << PB2);
+
+    SPCR = (1 << SPE) | (1 << MSTR);
+    setFrequency(1000000);
+
+    instance = this;
+}
+
+/** Set the frequency of the SPI interface
+  *
+  * @param frequency The bus frequency in hertz
+  */
+int ATMegaSPI::setFrequency(uint32_t frequency)
+{
+    // SPI2X, SPR1 and SPR0 for dividers of 2, 4, 8 ... 128.
+    static const uint8_t config[] = {0x04, 0x00, 0x05, 0x01, 0x06, 0x02, 0x03};
+    uint8_t i = 0;
+
+    if (frequency == 0)
+        return DEVICE_INVALID_PARAMETER;
+
+    while (i < 6 && (F_CPU >> (i + 1)) > frequency)
+        i++;
+
+    SPCR = (SPCR & ~((1 << SPR1) | (1 << SPR0))) | (config[i] & 0x03);
+
+    if (config[i] & 0x04)
+        SPSR |= (1 << SPI2X);
+    else
+        SPSR &= ~(1 << SPI2X);
+
+    return DEVICE_OK;
+}
+
+/** Set the mode of the SPI interface
+  *
+  * @param mode Clock polarity and phase mode (0 - 3)
+  * @param bits Number of bits per SPI frame. Only 8 is supported.
+  */
+int ATMegaSPI::setMode(int mode, int bits)
+{
+    if (mode < 0 || mode > 3)
+        return DEVICE_INVALID_PARAMETER;
+
+    if (bits != 8)
+        return DEVICE_NOT_SUPPORTED;
+
+    SPCR = (SPCR & ~((1 << CPOL) | (1 << CPHA))) | (mode << CPHA);
+
+    return DEVICE_OK;
+}
+
+/**
+  * Writes the given byte to the SPI bus.
+  *
+  * The CPU will busy wait until the transmission is complete.
+  *
+  * @param data The data to write.
+  * @return Response from the SPI slave, or DEVICE_BUSY if an asynchronous transfer is in progress.
+  */
+int ATMegaSPI::write(int data)
+{
+    if (SPI_BUSY)
+        return DEVICE_BUSY;
+
+    SPDR = data;
+    while (!SPI_DONE);
+
+    return SPDR;
+}
+
+/**
+  * Writes and reads from the SPI bus concurrently. Waits until the transfer is complete.
+  *
+  * The next byte to send is fetched whilst the current one is on the wire, and written as soon
+  * as the current byte has been read back, so the gap between bytes is only a few cycles.
+  */
+int ATMegaSPI::transfer(const uint8_t *txBuffer, uint32_t txSize, uint8_t *rxBuffer, uint32_t rxSize)
+{
+    uint32_t len = txSize > rxSize ? txSize : rxSize;
+    uint8_t next;
+
+    if (SPI_BUSY)
+        return DEVICE_BUSY;
+
+    if (txBuffer == NULL)
+        txSize = 0;
+
+    if (rxBuffer == NULL)
+        rxSize = 0;
+
+    if (len == 0)
+        return DEVICE_OK;
+
+    SPDR = txSize ? txBuffer[0] : SPI_FILL_BYTE;
+
+    for (uint32_t i = 1; i <= len; i++)
+    {
+        next = i < txSize ? txBuffer[i] : SPI_FILL_BYTE;
+
+        while (!SPI_DONE);
+        uint8_t data = SPDR;
+
+        if (i < len)
+            SPDR = next;
+
+        if (i <= rxSize)
+            rxBuffer[i - 1] = data;
+    }
+
+    return DEVICE_OK;
+}
+
+/**
+  * Starts an interrupt driven transfer, and returns immediately.
+  */
+int ATMegaSPI::startTransfer(const uint8_t *txBuffer, uint32_t txSize, uint8_t *rxBuffer, uint32_t rxSize,
+                             PVoidCallback doneHandler, void *arg)
+{
+    uint32_t len = txSize > rxSize ? txSize : rxSize;
+
+    if (SPI_BUSY)
+        return DEVICE_BUSY;
+
+    if (len > 0xffff)
+        return DEVICE_INVALID_PARAMETER;
+
+    this->txBuffer = txBuffer;
+    this->txSize = txBuffer ? txSize : 0;
+    this->rxBuffer = rxBuffer;
+    this->rxSize = rxBuffer ? rxSize : 0;
+    this->doneHandler = doneHandler;
+    this->doneHandlerArg = arg;
+
+    if (len == 0)
+    {
+        if (doneHandler)
+            doneHandler(arg);
+
+        return DEVICE_OK;
+    }
+
+    index = 0;
+    length = len;
+
+    // Discard any stale completion flag, so that the interrupt fires for this byte only.
+    (void)SPSR;
+    (void)SPDR;
+
+    SPCR |= (1 << SPIE);
+    SPDR = this->txSize ? txBuffer[0] : SPI_FILL_BYTE;
+
+    return DEVICE_OK;
+}
+
+/**
+  * Determines if an asynchronous transfer is in progress.
+  */
+int ATMegaSPI::isBusy()
+{
+    return SPI_BUSY ? 1 : 0;
+}
+
+/**
+  * Moves the next byte of an asynchronous transfer. Called from the SPI_STC interrupt.
+  */
+void ATMegaSPI::irq()
+{
+    uint16_t i = index;
+    uint8_t data = SPDR;
+
+    i++;
+
+    if (i < length)
+        SPDR = i < txSize ? txBuffer[i] : SPI_FILL_BYTE;
+
+    if (i <= rxSize)
+        rxBuffer[i - 1] = data;
+
+    index = i;
+
+    if (i >= length)
+    {
+        SPCR &= ~(1 << SPIE);
+
+        if (doneHandler)
+            doneHandler(doneHandlerArg);
+    }
+}
+
+}
@@ -34,6 +34,8 @@ DEALINGS IN THE SOFTWARE.
 
 using namespace codal;
 
+static const uint32_t POWERS_OF_TEN[] PROGMEM = {1UL, 10UL, 100UL, 1000UL, 10000UL, 100000UL, 1000000UL, 10000000UL, 100000000UL, 1000000000UL};
+
 /**
   * Constructor.
   */
@@ -85,6 +87,56 @@ int ATMegaSerial::send(const char *s)
     return DEVICE_OK;
 }
 
+/**
+ *
+ * Send the given program memory string on this serial port.
+ * This function will wait for any previous communication to complete before sending.
+ *
+ * @param s The string to send, as created by the F() macro.
+ * @return DEVICE_OK on success.
+ */
+int ATMegaSerial::send(const __FlashStringHelper *s)
+{
+    return sendP(reinterpret_cast<PGM_P>(s));
+}
+
+/**
+ *
+ * Send the given program memory string on this serial port.
+ * This function will wait for any previous communication to complete before sending.
+ *
+ * @param s A pointer into program memory, such as one created by PSTR() or declared PROGMEM.
+ * @return DEVICE_OK on success.
+ */
+int ATMegaSerial::sendP(PGM_P s)
+{
+    char c;
+
+    while ((c = pgm_read_byte(s++)) != 0)
+        sendChar(c);
+
+    return DEVICE_OK;
+}
+
+/**
+ *
+ * Send a block of bytes held in program memory, such as a PROGMEM table, on this serial port.
+ * This function will wait for any previous communication to complete before sending.
+ *
+ * @param buffer A pointer into program memory.
+ * @param len The number of bytes to send.
+ * @return DEVICE_OK on success.
+ */
+int ATMegaSerial::sendP(const void *buffer, int len)
+{
+    const uint8_t *p = (const uint8_t *)buffer;
+
+    while (len-- > 0)
+        sendChar(pgm_read_byte(p++));
+
+    return DEVICE_OK;
+}
+
 /**
  *
  * Send the given number on this serial port.
@@ -97,7 +149,7 @@ int ATMegaSerial::send(const uint16_t n)
 {
     int sh = 12;
 
-    send("0x");
+    sendP(PSTR("0x"));
     while (sh >= 0)
     {
         int d = (n >> sh) & 0xf;
@@ -109,6 +161,295 @@ int ATMegaSerial::send(const uint16_t n)
     return DEVICE_OK;
 }
 
+/**
+ * Sends the given character a number of times.
+ */
+void ATMegaSerial::sendRepeated(char c, uint8_t count)
+{
+    while (count--)
+        sendChar(c);
+}
+
+/**
+ * Sends the given number, padded to the given width.
+ *
+ * The number of digits is counted first, so that padding can be sent before the digits themselves,
+ * which are then generated most significant first directly into the transmitter.
+ *
+ * @param n The magnitude of the number to send.
+ * @param negative non-zero to precede the number with a minus sign.
+ * @param base 10 or 16.
+ * @param width The minimum number of characters to send.
+ * @param flags Any ATMEGA_SERIAL_FORMAT flags.
+ * @param decimals The number of decimal digits to place after a decimal point.
+ * @return DEVICE_OK on success.
+ */
+int ATMegaSerial::sendFormatted(uint32_t n, uint8_t negative, uint8_t base, uint8_t width, uint8_t flags, uint8_t decimals)
+{
+    uint8_t digits = 1;
+    uint8_t len;
+    uint8_t padding;
+
+    if (base == 16)
+    {
+        while (digits < 8 && (n >> (4 * digits)))
+            digits++;
+    }
+    else
+    {
+        while (digits < 10 && n >= pgm_read_dword(&POWERS_OF_TEN[digits]))
+            digits++;
+
+        // Always send at least one digit before the decimal point.
+        if (decimals && digits <= decimals)
+            digits = decimals + 1;
+    }
+
+    len = digits + (negative ? 1 : 0) + (decimals ? 1 : 0);
+    padding = width > len ? width - len : 0;
+
+    if (!(flags & (ATMEGA_SERIAL_FORMAT_LEFT | ATMEGA_SERIAL_FORMAT_ZERO_PAD)))
+        sendRepeated(' ', padding);
+
+    if (negative)
+        sendChar('-');
+
+    if ((flags & ATMEGA_SERIAL_FORMAT_ZERO_PAD) && !(flags & ATMEGA_SERIAL_FORMAT_LEFT))
+        sendRepeated('0', padding);
+
+    if (base == 16)
+    {
+        char alpha = (flags & ATMEGA_SERIAL_FORMAT_UPPER) ? 'A' : 'a';
+
+        while (digits--)
+        {
+            uint8_t d = (n >> (4 * digits)) & 0xf;
+            sendChar(d > 9 ? alpha + d - 10 : '0' + d);
+        }
+    }
+    else
+    {
+        while (digits--)
+        {
+            uint32_t p = pgm_read_dword(&POWERS_OF_TEN[digits]);
+            char c = '0';
+
+            while (n >= p)
+            {
+                n -= p;
+                c++;
+            }
+
+            if (decimals && digits == decimals - 1)
+                sendChar('.');
+
+            sendChar(c);
+        }
+    }
+
+    if (flags & ATMEGA_SERIAL_FORMAT_LEFT)
+        sendRepeated(' ', padding);
+
+    return DEVICE_OK;
+}
+
+/**
+ *
+ * Send the given signed number in decimal on this serial port.
+ * This function will wait for any previous communication to complete before sending.
+ *
+ * @param n The number to send
+ * @param width The minimum number of characters to send, including any sign.
+ * @param flags ATMEGA_SERIAL_FORMAT_ZERO_PAD and/or ATMEGA_SERIAL_FORMAT_LEFT.
+ * @return DEVICE_OK on success.
+ */
+int ATMegaSerial::sendDec(int32_t n, uint8_t width, uint8_t flags)
+{
+    return sendFormatted(n < 0 ? -(uint32_t)n : n, n < 0, 10, width, flags, 0);
+}
+
+/**
+ *
+ * Send the given unsigned number in decimal on this serial port.
+ * This function will wait for any previous communication to complete before sending.
+ *
+ * @param n The number to send
+ * @param width The minimum number of characters to send.
+ * @param flags ATMEGA_SERIAL_FORMAT_ZERO_PAD and/or ATMEGA_SERIAL_FORMAT_LEFT.
+ * @return DEVICE_OK on success.
+ */
+int ATMegaSerial::sendUnsigned(uint32_t n, uint8_t width, uint8_t flags)
+{
+    return sendFormatted(n, 0, 10, width, flags, 0);
+}
+
+/**
+ *
+ * Send the given number in hexadecimal on this serial port, without a prefix.
+ * This function will wait for any previous communication to complete before sending.
+ *
+ * @param n The number to send
+ * @param width The minimum number of digits to send.
+ * @param flags Any ATMEGA_SERIAL_FORMAT flags.
+ * @return DEVICE_OK on success.
+ */
+int ATMegaSerial::sendHex(uint32_t n, uint8_t width, uint8_t flags)
+{
+    return sendFormatted(n, 0, 16, width, flags, 0);
+}
+
+/**
+ *
+ * Send the given fixed point number in decimal on this serial port.
+ * This function will wait for any previous communication to complete before sending.
+ *
+ * @param n The number to send, scaled by 10^decimals.
+ * @param decimals The number of digits after the decimal point, from 0 to 9.
+ * @param width The minimum number of characters to send, including sign and decimal point.
+ * @param flags ATMEGA_SERIAL_FORMAT_ZERO_PAD and/or ATMEGA_SERIAL_FORMAT_LEFT.
+ * @return DEVICE_OK on success, or DEVICE_INVALID_PARAMETER if decimals is out of range.
+ */
+int ATMegaSerial::sendFixed(int32_t n, uint8_t decimals, uint8_t width, uint8_t flags)
+{
+    if (decimals > 9)
+        return DEVICE_INVALID_PARAMETER;
+
+    return sendFormatted(n < 0 ? -(uint32_t)n : n, n < 0, 10, width, flags, decimals);
+}
+
+/**
+ * Sends formatted text, reading the format string from RAM or program memory.
+ */
+int ATMegaSerial::format(const char *fmt, bool flash, va_list args)
+{
+    char c;
+
+    #define NEXT_FORMAT_CHAR() (c = flash ? pgm_read_byte(fmt++) : *fmt++)
+
+    while (NEXT_FORMAT_CHAR() != 0)
+    {
+        uint8_t flags = 0;
+        uint8_t width = 0;
+        bool isLong = false;
+
+        if (c != '%')
+        {
+            sendChar(c);
+            continue;
+        }
+
+        NEXT_FORMAT_CHAR();
+
+        if (c == '-')
+        {
+            flags |= ATMEGA_SERIAL_FORMAT_LEFT;
+            NEXT_FORMAT_CHAR();
+        }
+
+        if (c == '0')
+        {
+            flags |= ATMEGA_SERIAL_FORMAT_ZERO_PAD;
+            NEXT_FORMAT_CHAR();
+        }
+
+        while (c >= '0' && c <= '9')
+        {
+            width = width * 10 + (c - '0');
+            NEXT_FORMAT_CHAR();
+        }
+
+        if (c == 'l')
+        {
+            isLong = true;
+            NEXT_FORMAT_CHAR();
+        }
+
+        switch (c)
+        {
+            case 'd':
+            case 'i':
+            {
+                int32_t n = isLong ? va_arg(args, long) : va_arg(args, int);
+                sendFormatted(n < 0 ? -(uint32_t)n : n, n < 0, 10, width, flags, 0);
+                break;
+            }
+
+            case 'u':
+            case 'x':
+            case 'X':
+            {
+                uint32_t n = isLong ? va_arg(args, unsigned long) : va_arg(args, unsigned int);
+
+                if (c == 'X')
+                    flags |= ATMEGA_SERIAL_FORMAT_UPPER;
+
+                sendFormatted(n, 0, c == 'u' ? 10 : 16, width, flags, 0);
+                break;
+            }
+
+            case 'c':
+                sendChar((char)va_arg(args, int));
+                break;
+
+            case 's':
+                send(va_arg(args, const char *));
+                break;
+
+            case 'S':
+                sendP(va_arg(args, PGM_P));
+                break;
+
+            case 0:
+                return DEVICE_OK;
+
+            default:
+                sendChar(c);
+                break;
+        }
+    }
+
+    #undef NEXT_FORMAT_CHAR
+
+    return DEVICE_OK;
+}
+
+/**
+ *
+ * Send formatted text on this serial port.
+ * This function will wait for any previous communication to complete before sending.
+ *
+ * @param fmt The format string.
+ * @return DEVICE_OK on success.
+ */
+int ATMegaSerial::printf(const char *fmt, ...)
+{
+    va_list args;
+
+    va_start(args, fmt);
+    int result = format(fmt, false, args);
+    va_end(args);
+
+    return result;
+}
+
+/**
+ *
+ * Send formatted text on this serial port, using a format string held in program memory.
+ *
+ * @param fmt The format string, as created by the F() macro.
+ * @return DEVICE_OK on success.
+ */
+int ATMegaSerial::printf(const __FlashStringHelper *fmt, ...)
+{
+    va_list args;
+
+    va_start(args, fmt);
+    int result = format(reinterpret_cast<const char *>(fmt), true, args);
+    va_end(args);
+
+    return result;
+}
+
 /**
  * Configures this serial port for the givn board rate.
  *
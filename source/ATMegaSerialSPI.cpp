@@ -0,0 +1,186 @@
+/*
+The MIT License (MIT)
+
+Copyright (c) 2017 Lancaster University.
+
+Permission is hereby granted, free of charge, to any person obtaining a
+copy of this software and associated documentation files (the "Software"),
+to deal in the Software without restriction, including without limitation
+the rights to use, copy, modify, merge, publish, distribute, sublicense,
+and/or sell copies of the Software, and to permit persons to whom the
+Software is furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+DEALINGS IN THE SOFTWARE.
+*/
+
+#include "ATMegaSerialSPI.h"
+#include "ErrorNo.h"
+#include "avr/io.h"
+
+#define USART_TX_READY (UCSR0A & (1 << UDRE0))
+#define USART_RX_READY (UCSR0A & (1 << RXC0))
+#define USART_TX_DONE (UCSR0A & (1 << TXC0))
+
+#define SPI_FILL_BYTE 0xFF
+
+namespace codal
+{
+/**
+  * Constructor.
+  * Configures USART0 as an SPI master in mode 0 at 1MHz.
+  *
+  * @param mosi The TXD pin (PD1).
+  * @param miso The RXD pin (PD0).
+  * @param sclk The XCK pin (PD4).
+  */
+ATMegaSerialSPI::ATMegaSerialSPI(ATMegaPin &mosi, ATMegaPin &miso, ATMegaPin &sclk)
+{
+    // The baud rate register must be zero whilst the transmitter is enabled.
+    UBRR0 = 0;
+
+    // XCK must be an output to select master mode.
+    sclk.setDigitalValue(0);
+    mosi.setDigitalValue(0);
+    miso.getDigitalValue();
+
+    UCSR0C = (1 << UMSEL01) | (1 << UMSEL00);
+    UCSR0B = (1 << RXEN0) | (1 << TXEN0);
+
+    setFrequency(1000000);
+}
+
+/** Set the frequency of the SPI interface
+  *
+  * @param frequency The bus frequency in hertz
+  */
+int ATMegaSerialSPI::setFrequency(uint32_t frequency)
+{
+    uint32_t ubrr;
+
+    if (frequency == 0)
+        return DEVICE_INVALID_PARAMETER;
+
+    // Round the divider up, so we never exceed the requested frequency.
+    ubrr = ((F_CPU / 2) + frequency - 1) / frequency;
+    ubrr = ubrr ? ubrr - 1 : 0;
+
+    UBRR0 = ubrr > 4095 ? 4095 : ubrr;
+
+    return DEVICE_OK;
+}
+
+/** Set the mode of the SPI interface
+  *
+  * @param mode Clock polarity and phase mode (0 - 3)
+  * @param bits Number of bits per SPI frame. Only 8 is supported.
+  */
+int ATMegaSerialSPI::setMode(int mode, int bits)
+{
+    if (mode < 0 || mode > 3)
+        return DEVICE_INVALID_PARAMETER;
+
+    if (bits != 8)
+        return DEVICE_NOT_SUPPORTED;
+
+    UCSR0C = (1 << UMSEL01) | (1 << UMSEL00) | ((mode & 0x02) ? (1 << UCPOL0) : 0) | ((mode & 0x01) ? (1 << UCPHA0) : 0);
+
+    return DEVICE_OK;
+}
+
+/**
+  * Writes the given byte to the SPI bus.
+  *
+  * The CPU will busy wait until the transmission is complete.
+  *
+  * @param data The data to write.
+  * @return Response from the SPI slave.
+  */
+int ATMegaSerialSPI::write(int data)
+{
+    while (!USART_TX_READY);
+    UDR0 = data;
+
+    while (!USART_RX_READY);
+    return UDR0;
+}
+
+/**
+  * Writes and reads from the SPI bus concurrently. Waits until the transfer is complete.
+  */
+int ATMegaSerialSPI::transfer(const uint8_t *txBuffer, uint32_t txSize, uint8_t *rxBuffer, uint32_t rxSize)
+{
+    uint32_t len = txSize > rxSize ? txSize : rxSize;
+    uint32_t sent = 0;
+
+    if (txBuffer == NULL)
+        txSize = 0;
+
+    if (rxBuffer == NULL)
+        rxSize = 0;
+
+    // Fill both the shift register and the transmit buffer.
+    while (sent < len && sent < 2)
+    {
+        while (!USART_TX_READY);
+        UDR0 = sent < txSize ? txBuffer[sent] : SPI_FILL_BYTE;
+        sent++;
+    }
+
+    // Each received byte means a slot in the transmit buffer is about to free, so refill it
+    // as soon as UDRE0 confirms it; a write to a full buffer would be lost.
+    for (uint32_t received = 0; received < len; received++)
+    {
+        while (!USART_RX_READY);
+        uint8_t data = UDR0;
+
+        if (sent < len)
+        {
+            while (!USART_TX_READY);
+            UDR0 = sent < txSize ? txBuffer[sent] : SPI_FILL_BYTE;
+            sent++;
+        }
+
+        if (received < rxSize)
+            rxBuffer[received] = data;
+    }
+
+    return DEVICE_OK;
+}
+
+/**
+  * Streams the given bytes onto the bus, discarding anything received.
+  */
+int ATMegaSerialSPI::send(const uint8_t *buffer, uint32_t len)
+{
+    if (buffer == NULL)
+        return DEVICE_INVALID_PARAMETER;
+
+    if (len == 0)
+        return DEVICE_OK;
+
+    UCSR0B &= ~(1 << RXEN0);
+    UCSR0A = (1 << TXC0);
+
+    while (len--)
+    {
+        while (!USART_TX_READY);
+        UDR0 = *buffer++;
+    }
+
+    while (!USART_TX_DONE);
+
+    // Re-enabling the receiver leaves its buffer empty, ready for the next transfer.
+    UCSR0B |= (1 << RXEN0);
+
+    return DEVICE_OK;
+}
+}
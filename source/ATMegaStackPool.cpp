@@ -0,0 +1,368 @@
+/*
+The MIT License (MIT)
+
+Copyright (c) 2017 Lancaster University.
+
+Permission is hereby granted, free of charge, to any person obtaining a
+copy of this software and associated documentation files (the "Software"),
+to deal in the Software without restriction, including without limitation
+the rights to use, copy, modify, merge, publish, distribute, sublicense,
+and/or sell copies of the Software, and to permit persons to whom the
+Software is furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+DEALINGS IN THE SOFTWARE.
+*/
+
+#include "ATMegaStackPool.h"
+#include <avr/io.h>
+#include <avr/interrupt.h>
+
+#if (ATMEGA_STACK_POOL_SIZE % ATMEGA_STACK_POOL_MAX_BLOCK) != 0 || ATMEGA_STACK_POOL_SIZE == 0
+#error "ATMEGA_STACK_POOL_SIZE must be a multiple of ATMEGA_STACK_POOL_MAX_BLOCK"
+#endif
+
+#if ATMEGA_STACK_POOL_CLASSES > 0x7F
+#error "Too many ATMEGA_STACK_POOL_CLASSES"
+#endif
+
+#define BLOCK_SIZE(c)       ((uint16_t)1 << (ATMEGA_STACK_POOL_MIN_SHIFT + (c)))
+#define TOP_CLASS           (ATMEGA_STACK_POOL_CLASSES - 1)
+#define CLASS_NONE          0xFF
+
+// Tag byte at the start of every block: the size class, with this bit set if the block is free.
+#define TAG_FREE            0x80
+
+/**
+  * A free block. The tag is shared with allocated blocks, whose buffer follows it.
+  */
+struct StackPoolBlock
+{
+    uint8_t         tag;
+    StackPoolBlock  *next;
+    StackPoolBlock  *prev;
+};
+
+static_assert(sizeof(StackPoolBlock) <= BLOCK_SIZE(0), "ATMEGA_STACK_POOL_MIN_SHIFT is too small to hold a free block");
+
+static uint8_t arena[ATMEGA_STACK_POOL_SIZE];
+static StackPoolBlock *freeList[ATMEGA_STACK_POOL_CLASSES];
+static uint8_t initialised = 0;
+
+static uint16_t used = 0;
+static uint16_t peakUsed = 0;
+static uint16_t allocations = 0;
+static uint16_t failures = 0;
+static uint8_t inUse[ATMEGA_STACK_POOL_CLASSES];
+static uint8_t peak[ATMEGA_STACK_POOL_CLASSES];
+static uint8_t available[ATMEGA_STACK_POOL_CLASSES];
+
+/**
+  * Determines the smallest size class that holds the given number of bytes, after the header.
+  */
+static uint8_t size_class(uint16_t size)
+{
+    uint8_t c = 0;
+
+    while (c < ATMEGA_STACK_POOL_CLASSES && BLOCK_SIZE(c) - 1 < size)
+        c++;
+
+    return c < ATMEGA_STACK_POOL_CLASSES ? c : CLASS_NONE;
+}
+
+static void list_push(StackPoolBlock *block, uint8_t c)
+{
+    block->tag = TAG_FREE | c;
+    block->prev = NULL;
+    block->next = freeList[c];
+
+    if (block->next)
+        block->next->prev = block;
+
+    freeList[c] = block;
+    available[c]++;
+}
+
+static void list_remove(StackPoolBlock *block, uint8_t c)
+{
+    if (block->prev)
+        block->prev->next = block->next;
+    else
+        freeList[c] = block->next;
+
+    if (block->next)
+        block->next->prev = block->prev;
+
+    block->tag = c;
+    available[c]--;
+}
+
+/**
+  * Places every top level block on the free list. Must be called with interrupts disabled.
+  */
+static void pool_init()
+{
+    if (initialised)
+        return;
+
+    for (uint16_t offset = 0; offset < ATMEGA_STACK_POOL_SIZE; offset += ATMEGA_STACK_POOL_MAX_BLOCK)
+        list_push((StackPoolBlock *)&arena[offset], TOP_CLASS);
+
+    initialised = 1;
+}
+
+/**
+  * Frees a block, merging it with its buddy for as long as the buddy is free and whole.
+  * A buddy that is allocated or split starts with a tag of a different class, so never matches.
+  * Must be called with interrupts disabled.
+  */
+static void release(StackPoolBlock *block, uint8_t c)
+{
+    while (c < TOP_CLASS)
+    {
+        StackPoolBlock *buddy = (StackPoolBlock *)&arena[((uint8_t *)block - arena) ^ BLOCK_SIZE(c)];
+
+        if (buddy->tag != (TAG_FREE | c))
+            break;
+
+        list_remove(buddy, c);
+
+        if (buddy < block)
+            block = buddy;
+
+        c++;
+    }
+
+    list_push(block, c);
+}
+
+static void account(uint8_t c)
+{
+    used += BLOCK_SIZE(c);
+    if (used > peakUsed)
+        peakUsed = used;
+
+    if (++inUse[c] > peak[c])
+        peak[c] = inUse[c];
+}
+
+extern "C" {
+
+/**
+  * Allocates a buffer of at least the given size.
+  *
+  * @param size The number of bytes needed, at most ATMEGA_STACK_POOL_MAX_BUFFER.
+  *
+  * @return A pointer to the buffer, or NULL if the pool is exhausted.
+  */
+void *stack_pool_alloc(uint16_t size)
+{
+    uint8_t c = size_class(size);
+    StackPoolBlock *block = NULL;
+
+    uint8_t sreg = SREG;
+    cli();
+
+    pool_init();
+
+    if (c != CLASS_NONE)
+    {
+        // Take the smallest free block that fits, and split it down to size.
+        uint8_t k = c;
+        while (k < ATMEGA_STACK_POOL_CLASSES && freeList[k] == NULL)
+            k++;
+
+        if (k < ATMEGA_STACK_POOL_CLASSES)
+        {
+            block = freeList[k];
+            list_remove(block, k);
+
+            while (k > c)
+            {
+                k--;
+                list_push((StackPoolBlock *)((uint8_t *)block + BLOCK_SIZE(k)), k);
+            }
+
+            block->tag = c;
+        }
+    }
+
+    if (block)
+    {
+        allocations++;
+        account(c);
+    }
+    else
+    {
+        failures++;
+    }
+
+    SREG = sreg;
+
+    return block ? (uint8_t *)block + 1 : NULL;
+}
+
+/**
+  * Returns a buffer to the pool, merging it with any free buddy.
+  *
+  * @param buffer A buffer from the pool, or NULL.
+  */
+void stack_pool_free(void *buffer)
+{
+    if (buffer == NULL)
+        return;
+
+    StackPoolBlock *block = (StackPoolBlock *)((uint8_t *)buffer - 1);
+    uint8_t c = block->tag;
+
+    uint8_t sreg = SREG;
+    cli();
+
+    used -= BLOCK_SIZE(c);
+    inUse[c]--;
+    release(block, c);
+
+    SREG = sreg;
+}
+
+/**
+  * Determines the usable size of a buffer.
+  *
+  * @param buffer A buffer from the pool, or NULL.
+  *
+  * @return The number of bytes available in the buffer.
+  */
+uint16_t stack_pool_capacity(void *buffer)
+{
+    if (buffer == NULL)
+        return 0;
+
+    return BLOCK_SIZE(((uint8_t *)buffer)[-1]) - 1;
+}
+
+/**
+  * Ensures a stack buffer can hold the given number of bytes.
+  *
+  * @param buffer The current buffer, or NULL.
+  * @param size The number of bytes needed.
+  *
+  * @return The buffer to use, or NULL if the pool is exhausted, in which case the old buffer has
+  *         been released.
+  */
+void *stack_pool_grow(void *buffer, uint16_t size)
+{
+    if (buffer != NULL && stack_pool_capacity(buffer) >= size)
+        return buffer;
+
+    stack_pool_free(buffer);
+
+    return stack_pool_alloc(size);
+}
+
+/**
+  * Reduces a buffer to the smallest class that holds the given number of bytes, in place.
+  *
+  * @param buffer A buffer from the pool.
+  * @param size The number of bytes still needed.
+  *
+  * @return buffer, which is unchanged.
+  */
+void *stack_pool_shrink(void *buffer, uint16_t size)
+{
+    if (buffer == NULL)
+        return NULL;
+
+    StackPoolBlock *block = (StackPoolBlock *)((uint8_t *)buffer - 1);
+    uint8_t c = block->tag;
+    uint8_t target = size_class(size);
+
+    if (target == CLASS_NONE || target >= c)
+        return buffer;
+
+    uint8_t sreg = SREG;
+    cli();
+
+    used -= BLOCK_SIZE(c);
+    inUse[c]--;
+
+    // Release the upper half until the block is small enough. Each half's buddy is the block
+    // being kept, so none of them can merge yet.
+    while (c > target)
+    {
+        c--;
+        release((StackPoolBlock *)((uint8_t *)block + BLOCK_SIZE(c)), c);
+    }
+
+    block->tag = c;
+    account(c);
+
+    SREG = sreg;
+
+    return buffer;
+}
+
+/**
+  * The port hook for the scheduler's stack resize path.
+  *
+  * @param buffer The fiber's current buffer, or NULL.
+  * @param depth The depth of the fiber's stack, in bytes.
+  * @param capacity Set to the usable size of the buffer returned.
+  *
+  * @return The buffer to use, or NULL if the pool is exhausted.
+  */
+void *stack_pool_resize(void *buffer, uint16_t depth, uint16_t *capacity)
+{
+    uint16_t current = stack_pool_capacity(buffer);
+
+    if (buffer == NULL || current < depth)
+        buffer = stack_pool_grow(buffer, depth);
+    else if ((uint32_t)depth * 4 <= current)
+        buffer = stack_pool_shrink(buffer, depth * 2);
+
+    if (capacity)
+        *capacity = stack_pool_capacity(buffer);
+
+    return buffer;
+}
+
+/**
+  * Takes a snapshot of the pool's usage statistics.
+  *
+  * @param stats The structure to fill in.
+  */
+void stack_pool_get_stats(struct StackPoolStats *stats)
+{
+    uint8_t sreg = SREG;
+    cli();
+
+    pool_init();
+
+    stats->arenaSize = ATMEGA_STACK_POOL_SIZE;
+    stats->arenaUsed = used;
+    stats->peakUsed = peakUsed;
+    stats->largestFree = 0;
+    stats->allocations = allocations;
+    stats->failures = failures;
+
+    for (uint8_t c = 0; c < ATMEGA_STACK_POOL_CLASSES; c++)
+    {
+        stats->inUse[c] = inUse[c];
+        stats->peak[c] = peak[c];
+        stats->free[c] = available[c];
+
+        if (freeList[c])
+            stats->largestFree = BLOCK_SIZE(c);
+    }
+
+    SREG = sreg;
+}
+
+}
@@ -0,0 +1,188 @@
+/*
+The MIT License (MIT)
+
+Copyright (c) 2017 Lancaster University.
+
+Permission is hereby granted, free of charge, to any person obtaining a
+copy of this software and associated documentation files (the "Software"),
+to deal in the Software without restriction, including without limitation
+the rights to use, copy, modify, merge, publish, distribute, sublicense,
+and/or sell copies of the Software, and to permit persons to whom the
+Software is furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+DEALINGS IN THE SOFTWARE.
+*/
+
+#include "ATMegaTelemetry.h"
+#include "ErrorNo.h"
+#include <avr/pgmspace.h>
+#include <string.h>
+
+// CRC-16/CCITT remainders for each 4 bit value, polynomial 0x1021.
+static const uint16_t CRC16_NIBBLE_TABLE[16] PROGMEM = {
+    0x0000, 0x1021, 0x2042, 0x3063, 0x4084, 0x50A5, 0x60C6, 0x70E7,
+    0x8108, 0x9129, 0xA14A, 0xB16B, 0xC18C, 0xD1AD, 0xE1CE, 0xF1EF
+};
+
+using namespace codal;
+
+/**
+  * Constructor.
+  *
+  * @param serial The serial port to send frames on.
+  */
+ATMegaTelemetry::ATMegaTelemetry(ATMegaSerial &serial) : serial(serial)
+{
+    length = 0;
+}
+
+/**
+  * Computes the CRC-16 used by this protocol, four bits at a time from a 16 entry table.
+  */
+uint16_t ATMegaTelemetry::crc16(const uint8_t *data, uint8_t len)
+{
+    uint16_t crc = 0xffff;
+
+    while (len--)
+    {
+        uint8_t b = *data++;
+
+        crc = (crc << 4) ^ pgm_read_word(&CRC16_NIBBLE_TABLE[(crc >> 12) ^ (b >> 4)]);
+        crc = (crc << 4) ^ pgm_read_word(&CRC16_NIBBLE_TABLE[(crc >> 12) ^ (b & 0x0f)]);
+    }
+
+    return crc;
+}
+
+/**
+  * Starts a new record, discarding any record in progress.
+  *
+  * @param type The record type, identifying the layout of its payload to the receiver.
+  */
+void ATMegaTelemetry::begin(uint8_t type)
+{
+    buffer[0] = type;
+    length = 1;
+}
+
+/**
+  * Appends raw bytes to the record in progress.
+  *
+  * @return DEVICE_OK on success, or DEVICE_NO_RESOURCES if the payload is full.
+  */
+int ATMegaTelemetry::put(const void *data, uint8_t len)
+{
+    if (length == 0 || length + len > ATMEGA_TELEMETRY_MAX_PAYLOAD + 1)
+        return DEVICE_NO_RESOURCES;
+
+    // AVR is little endian, so fields can be copied as they are held in memory.
+    memcpy(&buffer[length], data, len);
+    length += len;
+
+    return DEVICE_OK;
+}
+
+int ATMegaTelemetry::putU8(uint8_t value)
+{
+    return put(&value, sizeof(value));
+}
+
+int ATMegaTelemetry::putU16(uint16_t value)
+{
+    return put(&value, sizeof(value));
+}
+
+int ATMegaTelemetry::putI16(int16_t value)
+{
+    return put(&value, sizeof(value));
+}
+
+int ATMegaTelemetry::putU32(uint32_t value)
+{
+    return put(&value, sizeof(value));
+}
+
+int ATMegaTelemetry::putI32(int32_t value)
+{
+    return put(&value, sizeof(value));
+}
+
+int ATMegaTelemetry::putFloat(float value)
+{
+    return put(&value, sizeof(value));
+}
+
+/**
+  * Completes the record in progress, and sends it as a single frame.
+  *
+  * The frame is COBS encoded as it is sent: each run of non-zero bytes (of at most 254) is
+  * preceded by its length plus one, and the zero that follows it is dropped.
+  *
+  * @return DEVICE_OK on success.
+  */
+int ATMegaTelemetry::end()
+{
+    uint8_t start = 0;
+
+    if (length == 0)
+        return DEVICE_OK;
+
+    uint16_t crc = crc16(buffer, length);
+    buffer[length++] = crc & 0xff;
+    buffer[length++] = crc >> 8;
+
+    while (1)
+    {
+        uint8_t end = start;
+
+        while (end < length && buffer[end] != 0 && end - start < 254)
+            end++;
+
+        serial.sendChar(end - start + 1);
+
+        for (uint8_t i = start; i < end; i++)
+            serial.sendChar(buffer[i]);
+
+        if (end == length)
+            break;
+
+        // A full run of 254 is not followed by an encoded zero.
+        start = buffer[end] == 0 ? end + 1 : end;
+    }
+
+    serial.sendChar(ATMEGA_TELEMETRY_DELIMITER);
+    length = 0;
+
+    return DEVICE_OK;
+}
+
+/**
+  * Sends a complete record in one call.
+  *
+  * @param type The record type.
+  * @param data The payload.
+  * @param len The length of the payload.
+  *
+  * @return DEVICE_OK on success, or DEVICE_INVALID_PARAMETER if the payload is too long.
+  */
+int ATMegaTelemetry::send(uint8_t type, const void *data, uint8_t len)
+{
+    begin(type);
+
+    if (put(data, len) != DEVICE_OK)
+    {
+        length = 0;
+        return DEVICE_INVALID_PARAMETER;
+    }
+
+    return end();
+}
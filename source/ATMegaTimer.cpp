@@ -40,9 +40,15 @@ DEALINGS IN THE SOFTWARE.
 #include "ErrorNo.h"
 #include <avr/io.h>
 #include <avr/interrupt.h>
+#include <avr/sleep.h>
+#include <string.h>
 
 #define MINIMUM_PERIOD 100
 
+// Longest interval between compare matches, in Timer1 ticks. Timer1 is free running, so elapsed time is
+// measured modulo 2^16: syncing at least every half of the counter range keeps TCNT1 - sigma from wrapping.
+#define MAXIMUM_PERIOD 0x8000
+
 #define LED PB5
 #define output_low(port,pin) port &= ~(1<<pin)
 #define output_high(port,pin) port |= (1<<pin)
@@ -59,17 +65,97 @@ ISR(TIMER1_COMPA_vect)
 {
     if (instance)
     {
+        // Woken from idle sleep by the timer: measure how late we are.
+        if (instance->sleeping)
+        {
+            instance->sleeping = 0;
+            instance->stats.wakeLatency = TCNT1 - OCR1A;
+        }
+
         instance->syncRequest();
 
-        OCR1A = instance->period;
-        TCNT1 = 0;
-        instance->sigma = 0;
+        // Timer1 is free running (its count is also used to timestamp input capture events),
+        // so schedule the next compare match relative to the current count.
+        OCR1A = TCNT1 + instance->period;
 
         instance->trigger();
     }
 }
 
 
+#ifdef ATMEGA_TIMER2_ASYNC
+// Microseconds slept not yet added to the system time, scaled by ATMEGA_TIMER2_HZ.
+static uint32_t asyncRemainder = 0;
+
+ISR(TIMER2_COMPA_vect)
+{
+    // Timer1 was stopped during sleep, so its count since sleeping is the time taken to wake.
+    if (instance && instance->sleeping)
+    {
+        instance->sleeping = 0;
+        instance->stats.wakeLatency = TCNT1 - instance->sleepStart;
+    }
+}
+
+/**
+ * Waits for writes to the asynchronous Timer2 registers to reach the Timer2 clock domain.
+ */
+static void timer2Sync()
+{
+    while (ASSR & ((1 << TCN2UB) | (1 << OCR2AUB) | (1 << OCR2BUB) | (1 << TCR2AUB) | (1 << TCR2BUB)));
+}
+
+/**
+ * Determines if any peripheral needs the I/O clock (and so Timer1) to keep running,
+ * or can only wake the CPU from idle.
+ */
+static int clockInUse()
+{
+    // Timer0 (e.g. ADC streaming), input capture and the preemption time slice.
+    if ((TCCR0B & 0x07) || (TIMSK1 & ((1 << ICIE1) | (1 << OCIE1B))))
+        return 1;
+
+    // Pin changes are timestamped from Timer1.
+    if (PCICR)
+        return 1;
+
+    // Interrupt driven USART, SPI and EEPROM transfers.
+    if ((UCSR0B & ((1 << RXCIE0) | (1 << TXCIE0) | (1 << UDRIE0))) || (UCSR0A & (1 << UDRE0)) == 0)
+        return 1;
+
+    if ((SPCR & (1 << SPIE)) || (EECR & (1 << EERIE)))
+        return 1;
+
+    // A TWI transaction in progress, e.g. an ATMegaI2CSlave between its address match and the STOP.
+    // Only address recognition runs without the I/O clock, so the rest of the transfer would stall.
+    // Between transactions the status reads 0xF8 (no relevant state).
+    if ((TWCR & (1 << TWEN)) && (TWSR & 0xF8) != 0xF8)
+        return 1;
+
+    // Timer triggered ADC conversions.
+    if ((ADCSRA & (1 << ADEN)) && (ADCSRA & (1 << ADATE)))
+        return 1;
+
+    return 0;
+}
+
+/**
+ * Waits for the USART to shift out the byte it may still be sending, which would otherwise be cut short
+ * by stopping the I/O clock. This is at most one frame, as the data register is known to be empty.
+ */
+static void serialDrain()
+{
+    if (!(UCSR0B & (1 << TXEN0)))
+        return;
+
+    uint32_t cycles = 10UL * (((uint16_t)UBRR0H << 8 | UBRR0L) + 1) * ((UCSR0A & (1 << U2X0)) ? 8 : 16);
+    uint16_t ticks = cycles / 8 + 1;
+    uint16_t start = TCNT1;
+
+    while ((uint16_t)(TCNT1 - start) < ticks);
+}
+#endif
+
 /**
  * Constructor for a generic system clock interface.
  */
@@ -93,6 +179,20 @@ ATMegaTimer::ATMegaTimer() : Timer()
 	// Configure initial trigger event period.
     OCR1A = period;
 
+    sleeping = 0;
+    memset(&stats, 0, sizeof(stats));
+
+#ifdef ATMEGA_TIMER2_ASYNC
+    // Clock Timer2 from the 32.768kHz crystal, free running, to wake us from the deeper sleep modes.
+    TIMSK2 = 0;
+    ASSR = (1 << AS2);
+    TCNT2 = 0;
+    TCCR2A = 0;
+    TCCR2B = (1 << CS21);
+    timer2Sync();
+    TIFR2 = (1 << OCF2B) | (1 << OCF2A) | (1 << TOV2);
+#endif
+
     // Enable interrupts
     sei();
 
@@ -116,8 +216,7 @@ void ATMegaTimer::triggerIn(CODAL_TIMESTAMP t)
     if (t < MINIMUM_PERIOD)
         t = MINIMUM_PERIOD;
 
-    period = (t << 1) < (CODAL_TIMESTAMP)0xffff ? (t << 1) : 0xffff;
-    sigma = 0;
+    period = (t << 1) < (CODAL_TIMESTAMP)MAXIMUM_PERIOD ? (t << 1) : MAXIMUM_PERIOD;
 
     //SERIAL_DEBUG->send("REQUEST_TRIGGER_IN:");
     //uint16_t a = (t & (0xffff0000)) >> 16;
@@ -131,8 +230,7 @@ void ATMegaTimer::triggerIn(CODAL_TIMESTAMP t)
     //SERIAL_DEBUG->send(period);
     //SERIAL_DEBUG->send("\n");
 
-    TCNT1 = 0;
-    OCR1A = period;
+    OCR1A = TCNT1 + period;
 }
 
 /**
@@ -146,7 +244,9 @@ void ATMegaTimer::syncRequest()
 	// Snapshot timer
     uint16_t snapshot = TCNT1;
     uint16_t elapsed = (snapshot - sigma) >> 1;
-    sigma = snapshot;
+
+    // Only consume whole microseconds, so that odd half-microsecond ticks carry over to the next sync.
+    sigma += elapsed << 1;
 
     //SERIAL_DEBUG->send("ELAPSED:");
     //SERIAL_DEBUG->send(elapsed);
@@ -163,6 +263,146 @@ void ATMegaTimer::start()
     running = 1;
 }
 
+/**
+ * Sleeps until the next interrupt, in the deepest mode compatible with the peripherals in use.
+ * Intended to be called from the scheduler's idle loop, whenever every fiber is blocked.
+ */
+void ATMegaTimer::idle()
+{
+    uint8_t mode = ATMEGA_TIMER_SLEEP_IDLE;
+
+#ifdef ATMEGA_TIMER2_ASYNC
+    uint8_t wake = 0;
+    uint8_t start2 = 0;
+
+    // Let the USART finish its last byte first, but only if a deeper sleep is likely to follow.
+    if (running && !clockInUse() && (uint16_t)(OCR1A - TCNT1) >> 1 >= ATMEGA_TIMER_MIN_DEEP_SLEEP_US)
+        serialDrain();
+
+    cli();
+
+    // Check again with interrupts disabled, and ensure the compare match has not already passed.
+    if (running && !clockInUse() && !(TIFR1 & (1 << OCF1A)))
+    {
+        uint16_t remaining = (uint16_t)(OCR1A - TCNT1) >> 1;
+
+        if (remaining >= ATMEGA_TIMER_MIN_DEEP_SLEEP_US)
+        {
+            // Wake one Timer2 tick early rather than late; Timer1 covers the rest.
+            wake = ((uint32_t)remaining * ATMEGA_TIMER2_HZ) / 1000000UL;
+            if (wake > 1)
+                wake--;
+
+            // A conversion in progress can use ADC noise reduction, which also leaves Timer2 running.
+            mode = ((ADCSRA & (1 << ADSC)) && (ADCSRA & (1 << ADIE))) ? ATMEGA_TIMER_SLEEP_ADC : ATMEGA_TIMER_SLEEP_POWER_SAVE;
+        }
+    }
+
+    if (mode != ATMEGA_TIMER_SLEEP_IDLE)
+    {
+        // Count from a Timer2 edge. Taking start2 part way through a tick would count the whole of
+        // that tick as slept, gaining half a tick (122us) per sleep on average. The wait is at most
+        // one tick, which the early wake above allows for.
+        start2 = TCNT2;
+        while (TCNT2 == start2);
+        start2++;
+
+        // Writing OCR2A and waiting for it to complete is also what the datasheet requires
+        // before re-entering power-save.
+        OCR2A = start2 + wake;
+        timer2Sync();
+        TIFR2 = (1 << OCF2A);
+        TIMSK2 = (1 << OCIE2A);
+
+        set_sleep_mode(mode == ATMEGA_TIMER_SLEEP_ADC ? SLEEP_MODE_ADC : SLEEP_MODE_PWR_SAVE);
+    }
+    else
+#else
+    cli();
+#endif
+    {
+        set_sleep_mode(SLEEP_MODE_IDLE);
+    }
+
+    sleepStart = TCNT1;
+    sleeping = 1;
+
+    // sei only takes effect after the following instruction, so no wake up interrupt can slip in before we sleep.
+    sleep_enable();
+    sei();
+    sleep_cpu();
+    sleep_disable();
+
+    cli();
+
+    uint32_t slept;
+
+#ifdef ATMEGA_TIMER2_ASYNC
+    if (mode != ATMEGA_TIMER_SLEEP_IDLE)
+    {
+        TIMSK2 = 0;
+
+        // TCNT2 may read stale immediately after waking, until a register write has synchronised.
+        TCCR2B = (1 << CS21);
+        timer2Sync();
+
+        asyncRemainder += (uint32_t)(uint8_t)(TCNT2 - start2) * 1000000UL;
+
+        // Woken by another interrupt, part way through a tick: count half of it, the average.
+        if (sleeping)
+            asyncRemainder += 1000000UL / 2;
+        slept = asyncRemainder / ATMEGA_TIMER2_HZ;
+        asyncRemainder -= slept * ATMEGA_TIMER2_HZ;
+
+        // Timer1 was stopped, so advance the system time by the time slept and service any timer events now due.
+        if (running)
+        {
+            sync(slept);
+            trigger();
+        }
+    }
+    else
+#endif
+    {
+        slept = (uint16_t)(TCNT1 - sleepStart) >> 1;
+    }
+
+    sleeping = 0;
+
+    stats.sleepUs[mode] += slept;
+    stats.count[mode]++;
+
+    if (stats.wakeLatency > stats.maxWakeLatency)
+        stats.maxWakeLatency = stats.wakeLatency;
+
+    sei();
+}
+
+/**
+ * Sleeps until the next interrupt via the system timer's idle(), if one has been created.
+ *
+ * The port hook for the scheduler's idle loop: call it from target_wait_for_event() in the target's HAL,
+ * which codal-core's idle fiber calls whenever every fiber is blocked.
+ */
+void codal::atmega_timer_idle()
+{
+    if (instance)
+        instance->idle();
+}
+
+/**
+ * Retrieves the statistics gathered by idle().
+ *
+ * @param stats The structure to fill in.
+ */
+void ATMegaTimer::getSleepStats(TimerSleepStats *stats)
+{
+    uint8_t sreg = SREG;
+    cli();
+    memcpy(stats, &this->stats, sizeof(TimerSleepStats));
+    SREG = sreg;
+}
+
 /**
  * Destructor for this Timer instance
  */
@@ -0,0 +1,281 @@
+/*
+The MIT License (MIT)
+
+Copyright (c) 2017 Lancaster University.
+
+Permission is hereby granted, free of charge, to any person obtaining a
+copy of this software and associated documentation files (the "Software"),
+to deal in the Software without restriction, including without limitation
+the rights to use, copy, modify, merge, publish, distribute, sublicense,
+and/or sell copies of the Software, and to permit persons to whom the
+Software is furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+DEALINGS IN THE SOFTWARE.
+*/
+
+#include "ATMegaTouchSensor.h"
+#include "Button.h"
+#include "ErrorNo.h"
+#include "Event.h"
+#include <avr/io.h>
+#include <avr/interrupt.h>
+#include <util/delay.h>
+
+#if (ATMEGA_TOUCH_WINDOW % 8) != 0
+#error "ATMEGA_TOUCH_WINDOW must be a multiple of 8"
+#endif
+
+#if ATMEGA_TOUCH_MAX_PINS > 8
+#error "ATMEGA_TOUCH_MAX_PINS must be no more than 8"
+#endif
+
+// Enable the pull ups on the released pins, then sample the port into the buffer, unrolled
+// eight times so each sample takes three cycles (plus three for every eight to loop).
+#define TOUCH_CAPTURE(portreg, pinreg)                                  \
+    asm volatile(                                                       \
+        "out  %[port], %[release]\n\t"                                  \
+        "1:\n\t"                                                        \
+        ".rept 8\n\t"                                                   \
+        "in   __tmp_reg__, %[pin]\n\t"                                  \
+        "st   %a[ptr]+, __tmp_reg__\n\t"                                \
+        ".endr\n\t"                                                     \
+        "dec  %[n]\n\t"                                                 \
+        "brne 1b\n\t"                                                   \
+        : [ptr] "+e" (ptr), [n] "+r" (n)                                \
+        : [port] "I" (_SFR_IO_ADDR(portreg)), [pin] "I" (_SFR_IO_ADDR(pinreg)), [release] "r" (release) \
+        : "memory"                                                      \
+    )
+
+using namespace codal;
+
+/**
+  * Releases the discharged pins in 'mask' and samples the port until the window is full.
+  * Must be called with interrupts disabled.
+  */
+static void touch_capture(uint8_t port, uint8_t mask, uint8_t *samples)
+{
+    uint8_t *ptr = samples;
+    uint8_t n = ATMEGA_TOUCH_WINDOW / 8;
+    uint8_t release = *PORT_REG[port] | mask;
+
+    switch (port)
+    {
+        case 0:
+            TOUCH_CAPTURE(PORTB, PINB);
+            break;
+
+        case 1:
+            TOUCH_CAPTURE(PORTC, PINC);
+            break;
+
+        case 2:
+            TOUCH_CAPTURE(PORTD, PIND);
+            break;
+    }
+}
+
+/**
+  * Constructor.
+  * Create a touch sensor with no pins.
+  *
+  * @param id The unique EventModel id of this component.
+  * @param threshold The increase in reading over the baseline that is considered a touch.
+  */
+ATMegaTouchSensor::ATMegaTouchSensor(uint16_t id, uint8_t threshold)
+{
+    this->id = id;
+    this->status = 0;
+    this->threshold = threshold;
+
+    count = 0;
+    touched = 0;
+}
+
+/**
+  * Configures the given pin as a touch input (IO_STATUS_TOUCH_IN), and begins sensing it.
+  *
+  * @param pin The pin attached to the touch pad.
+  *
+  * @return DEVICE_OK on success, DEVICE_NOT_SUPPORTED if the pin has no digital capability,
+  *         or DEVICE_NO_RESOURCES if the sensor is full.
+  */
+int ATMegaTouchSensor::addPin(ATMegaPin &pin)
+{
+    if (indexOf(pin) >= 0)
+        return DEVICE_OK;
+
+    if (count >= ATMEGA_TOUCH_MAX_PINS)
+        return DEVICE_NO_RESOURCES;
+
+    // Drive the pad LO. This also verifies the pin has digital capability.
+    int result = pin.setDigitalValue(0);
+    if (result != DEVICE_OK)
+        return result;
+
+    pin.status = IO_STATUS_TOUCH_IN;
+
+    // Start from a baseline no reading can exceed, so the first scan cannot register a touch.
+    pins[count] = &pin;
+    reading[count] = 0;
+    baseline[count] = 0xffff;
+    count++;
+
+    // Establish a baseline for the new pad.
+    scan();
+    baseline[count - 1] = reading[count - 1] << ATMEGA_TOUCH_BASELINE_SHIFT;
+
+    status |= DEVICE_COMPONENT_STATUS_SYSTEM_TICK;
+
+    return DEVICE_OK;
+}
+
+/**
+  * Determines the index of the given pin, or -1 if it is not sensed.
+  */
+int ATMegaTouchSensor::indexOf(ATMegaPin &pin)
+{
+    for (int i = 0; i < count; i++)
+        if (pins[i] == &pin)
+            return i;
+
+    return -1;
+}
+
+/**
+  * Measures every pad, updating baselines and raising events as necessary.
+  */
+void ATMegaTouchSensor::scan()
+{
+    uint8_t samples[ATMEGA_TOUCH_WINDOW];
+
+    for (int i = 0; i < count; i++)
+        reading[i] = 0;
+
+    for (uint8_t port = 0; port < 3; port++)
+    {
+        uint8_t mask = 0;
+
+        for (int i = 0; i < count; i++)
+            if (ATMEGA_PIN_PORT(pins[i]->name) == port)
+                mask |= ATMEGA_PIN_MASK(pins[i]->name);
+
+        if (mask == 0)
+            continue;
+
+        for (int r = 0; r < ATMEGA_TOUCH_REPEATS; r++)
+        {
+            // Let the pads discharge (they are left driven LO between measurements).
+            _delay_us(ATMEGA_TOUCH_DISCHARGE_US);
+
+            uint8_t sreg = SREG;
+            cli();
+
+            // Float the pads whilst still LO, then release them onto the pull ups together.
+            *DD_REG[port] &= ~mask;
+            touch_capture(port, mask, samples);
+
+            *PORT_REG[port] &= ~mask;
+            *DD_REG[port] |= mask;
+
+            SREG = sreg;
+
+            for (int i = 0; i < count; i++)
+            {
+                uint8_t bit = ATMEGA_PIN_MASK(pins[i]->name);
+                uint8_t t = 0;
+
+                if (ATMEGA_PIN_PORT(pins[i]->name) != port)
+                    continue;
+
+                while (t < ATMEGA_TOUCH_WINDOW && !(samples[t] & bit))
+                    t++;
+
+                reading[i] += t;
+            }
+        }
+    }
+
+    for (int i = 0; i < count; i++)
+    {
+        uint16_t level = baseline[i] >> ATMEGA_TOUCH_BASELINE_SHIFT;
+        uint8_t bit = 1 << i;
+
+        if (!(touched & bit))
+        {
+            if (reading[i] >= level + threshold)
+            {
+                touched |= bit;
+                Event(pins[i]->id, DEVICE_BUTTON_EVT_DOWN);
+            }
+            else
+            {
+                // Track slow drift (temperature, humidity) whilst the pad is untouched.
+                baseline[i] += (int16_t)reading[i] - (int16_t)level;
+            }
+        }
+        else if (reading[i] < level + (threshold >> 1))
+        {
+            // Release with hysteresis, at half the touch threshold.
+            touched &= ~bit;
+            Event(pins[i]->id, DEVICE_BUTTON_EVT_UP);
+        }
+    }
+}
+
+/**
+  * Resets the baseline of every pad to its current reading.
+  */
+void ATMegaTouchSensor::calibrate()
+{
+    for (int i = 0; i < count; i++)
+        baseline[i] = reading[i] << ATMEGA_TOUCH_BASELINE_SHIFT;
+
+    touched = 0;
+}
+
+/**
+  * Determines if the given pad is currently touched.
+  *
+  * @return 1 if touched, 0 if not, or DEVICE_INVALID_PARAMETER if the pin is not sensed.
+  */
+int ATMegaTouchSensor::isTouched(ATMegaPin &pin)
+{
+    int i = indexOf(pin);
+
+    if (i < 0)
+        return DEVICE_INVALID_PARAMETER;
+
+    return (touched & (1 << i)) ? 1 : 0;
+}
+
+/**
+  * Obtains the most recent raw reading of the given pad.
+  *
+  * @return the summed charge time, in port samples, or DEVICE_INVALID_PARAMETER if the pin is not sensed.
+  */
+int ATMegaTouchSensor::getReading(ATMegaPin &pin)
+{
+    int i = indexOf(pin);
+
+    if (i < 0)
+        return DEVICE_INVALID_PARAMETER;
+
+    return reading[i];
+}
+
+/**
+  * Periodic callback, used to scan the pads in the background.
+  */
+void ATMegaTouchSensor::periodicCallback()
+{
+    scan();
+}
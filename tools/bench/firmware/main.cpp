@@ -0,0 +1,214 @@
+/*
+The MIT License (MIT)
+
+Copyright (c) 2017 Lancaster University.
+
+Permission is hereby granted, free of charge, to any person obtaining a
+copy of this software and associated documentation files (the "Software"),
+to deal in the Software without restriction, including without limitation
+the rights to use, copy, modify, merge, publish, distribute, sublicense,
+and/or sell copies of the Software, and to permit persons to whom the
+Software is furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+DEALINGS IN THE SOFTWARE.
+*/
+
+/**
+  * Peripheral throughput benchmarks for the ATMega328p drivers.
+  *
+  * Built as the application of a codal-atmega328p target, and run under simavr by tools/bench/run.py.
+  * Each benchmark is timed with the free running Timer1 (0.5us ticks at 16MHz), in batches shorter
+  * than its 32ms wrap, and reports one line on the serial port:
+  *
+  *     @<benchmark> <key>=<value> ...
+  *
+  * The run ends with "@end", after which the CPU sleeps with interrupts disabled so the simulator halts.
+  * The system timer runs throughout, so results include its interrupt overhead as an application would see.
+  */
+
+#include "ATMegaTimer.h"
+#include "ATMegaSerial.h"
+#include "ATMegaPin.h"
+#include "ATMegaI2C.h"
+#include <avr/io.h>
+#include <avr/interrupt.h>
+#include <avr/sleep.h>
+
+using namespace codal;
+
+// Timer1 runs at F_CPU / 8.
+#define TICKS_PER_SECOND            (F_CPU / 8)
+#define CYCLES_PER_TICK             8
+
+// The simulated 24C02 style EEPROM / sensor register map, as an 8 bit (write) address.
+#define BENCH_I2C_ADDRESS           0xA0
+#define BENCH_I2C_LENGTH            16
+
+#define BENCH_PIN_ITERATIONS        1000
+#define BENCH_SERIAL_BYTES          1024
+#define BENCH_SERIAL_BATCH          256
+#define BENCH_I2C_ITERATIONS        8
+#define BENCH_ADC_SAMPLES           128
+
+static uint16_t ticks()
+{
+    uint8_t sreg = SREG;
+    cli();
+    uint16_t t = TCNT1;
+    SREG = sreg;
+
+    return t;
+}
+
+static uint32_t perSecond(uint32_t count, uint32_t elapsed)
+{
+    // count is at most a few thousand, so this does not overflow.
+    return elapsed ? count * TICKS_PER_SECOND / elapsed : 0;
+}
+
+static void benchPin(ATMegaSerial &serial)
+{
+    ATMegaPin out(5, PIN_CAPABILITY_DIGITAL);
+    ATMegaPin in(4, PIN_CAPABILITY_DIGITAL);
+
+    uint16_t start = ticks();
+    for (int i = 0; i < BENCH_PIN_ITERATIONS; i++)
+        out.setDigitalValue(i & 1);
+    uint32_t toggle = (uint16_t)(ticks() - start);
+
+    int sum = 0;
+    start = ticks();
+    for (int i = 0; i < BENCH_PIN_ITERATIONS; i++)
+        sum += in.getDigitalValue();
+    uint32_t read = (uint16_t)(ticks() - start);
+
+    serial.printf(F("@pin_toggle toggles_per_s=%lu cycles_per_toggle=%lu\n"),
+                  perSecond(BENCH_PIN_ITERATIONS, toggle), toggle * CYCLES_PER_TICK / BENCH_PIN_ITERATIONS);
+
+    serial.printf(F("@pin_read reads_per_s=%lu cycles_per_read=%lu high=%d\n"),
+                  perSecond(BENCH_PIN_ITERATIONS, read), read * CYCLES_PER_TICK / BENCH_PIN_ITERATIONS, sum);
+}
+
+static void benchSerial(ATMegaSerial &serial)
+{
+    uint32_t total = 0;
+    uint32_t driver = 0;
+
+    // Drain anything still queued, so each batch starts with an empty transmitter.
+    while (!(UCSR0A & (1 << UDRE0)));
+
+    for (int batch = 0; batch < BENCH_SERIAL_BYTES / BENCH_SERIAL_BATCH; batch++)
+    {
+        uint16_t start = ticks();
+
+        for (int i = 0; i < BENCH_SERIAL_BATCH; i++)
+        {
+            // Time the driver itself separately from the wait for the data register.
+            while (!(UCSR0A & (1 << UDRE0)));
+
+            uint16_t t = ticks();
+            serial.sendChar(i == BENCH_SERIAL_BATCH - 1 ? '\n' : 'U');
+            driver += (uint16_t)(ticks() - t);
+        }
+
+        total += (uint16_t)(ticks() - start);
+    }
+
+    // The driver blocks whilst the data register is full, so the rest of the time is spent spinning.
+    serial.printf(F("@serial bytes_per_s=%lu driver_cycles_per_byte=%lu cpu_occupancy_permille=%lu\n"),
+                  perSecond(BENCH_SERIAL_BYTES, total), driver * CYCLES_PER_TICK / BENCH_SERIAL_BYTES,
+                  total ? driver * 1000 / total : 0);
+}
+
+static void benchI2C(ATMegaSerial &serial, ATMegaI2C &i2c, uint32_t frequency)
+{
+    uint8_t buffer[BENCH_I2C_LENGTH + 1];
+    int errors = 0;
+
+    i2c.setFrequency(frequency);
+
+    // Register address, then a known pattern.
+    buffer[0] = 0;
+    for (int i = 0; i < BENCH_I2C_LENGTH; i++)
+        buffer[i + 1] = (uint8_t)(frequency >> 10) + i;
+
+    uint16_t start = ticks();
+    i2c.write(BENCH_I2C_ADDRESS, buffer, BENCH_I2C_LENGTH + 1);
+    uint32_t write = (uint16_t)(ticks() - start);
+
+    uint32_t read = 0;
+
+    for (int n = 0; n < BENCH_I2C_ITERATIONS; n++)
+    {
+        uint8_t reg = 0;
+
+        start = ticks();
+        i2c.write(BENCH_I2C_ADDRESS, &reg, 1, true);
+        i2c.read(BENCH_I2C_ADDRESS, buffer, BENCH_I2C_LENGTH);
+        read += (uint16_t)(ticks() - start);
+
+        for (int i = 0; i < BENCH_I2C_LENGTH; i++)
+            if (buffer[i] != (uint8_t)((uint8_t)(frequency >> 10) + i))
+                errors++;
+    }
+
+    serial.printf(F("@i2c_%lu write_us=%lu read_us=%lu read_bytes_per_s=%lu errors=%d\n"),
+                  frequency / 1000, write / 2, read / 2 / BENCH_I2C_ITERATIONS,
+                  perSecond((uint32_t)BENCH_I2C_LENGTH * BENCH_I2C_ITERATIONS, read), errors);
+}
+
+static void benchADC(ATMegaSerial &serial)
+{
+    ATMegaPin a0(8, PIN_CAPABILITY_AD);
+    uint32_t sum = 0;
+
+    // The first conversion also configures the ADC, so leave it out.
+    a0.getAnalogValue();
+
+    uint16_t start = ticks();
+    for (int i = 0; i < BENCH_ADC_SAMPLES; i++)
+        sum += a0.getAnalogValue();
+    uint32_t elapsed = (uint16_t)(ticks() - start);
+
+    serial.printf(F("@adc samples_per_s=%lu us_per_sample=%lu mean=%lu\n"),
+                  perSecond(BENCH_ADC_SAMPLES, elapsed), elapsed / 2 / BENCH_ADC_SAMPLES, sum / BENCH_ADC_SAMPLES);
+}
+
+int main()
+{
+    ATMegaTimer timer;
+    ATMegaSerial serial;
+    ATMegaPin sda(12, PIN_CAPABILITY_DIGITAL);
+    ATMegaPin scl(13, PIN_CAPABILITY_DIGITAL);
+    ATMegaI2C i2c(sda, scl);
+
+    timer.start();
+
+    serial.printf(F("@start f_cpu=%lu\n"), (uint32_t)F_CPU);
+
+    benchPin(serial);
+    benchSerial(serial);
+    benchI2C(serial, i2c, 100000);
+    benchI2C(serial, i2c, 400000);
+    benchADC(serial);
+
+    serial.printf(F("@end\n"));
+    while (!(UCSR0A & (1 << UDRE0)));
+
+    // Sleeping with interrupts disabled halts the simulator.
+    cli();
+    set_sleep_mode(SLEEP_MODE_PWR_DOWN);
+    sleep_enable();
+    sleep_cpu();
+
+    return 0;
+}
@@ -0,0 +1,152 @@
+#!/usr/bin/env python3
+"""
+Runs the peripheral benchmark firmware under simavr and reports the results as JSON.
+
+The firmware (firmware/main.cpp) is built as the application of a codal-atmega328p target,
+and the simulator host (sim/bench_sim.c) with `make -C sim`. Each "@<benchmark> key=value ..."
+line the firmware prints becomes an object in the "benchmarks" section of the output.
+
+Usage:
+    run.py build/bench.elf > results.json
+    run.py build/bench.elf --compare previous.json
+    run.py --selftest
+
+With --compare, every metric also carries its value in the earlier run and the percentage change,
+so a driver change can be compared run to run.
+
+Status: the firmware and the simulator host have not yet been built or run, as avr-gcc and simavr
+were unavailable where they were written. Only --selftest has been exercised, and no JSON results
+exist yet, so the first real run is also the baseline for --compare.
+"""
+
+import argparse
+import json
+import os
+import subprocess
+import sys
+
+DEFAULT_SIM = os.path.join(os.path.dirname(os.path.abspath(__file__)), "sim", "bench_sim")
+
+
+def parse_value(text):
+    try:
+        return int(text, 0)
+    except ValueError:
+        return text
+
+
+def parse(lines):
+    """Converts the firmware's result lines into a dictionary."""
+    results = {"benchmarks": {}}
+    for line in lines:
+        line = line.strip()
+        if not line.startswith("@"):
+            continue
+        fields = line[1:].split()
+        name, values = fields[0], {}
+        for field in fields[1:]:
+            key, _, value = field.partition("=")
+            values[key] = parse_value(value)
+        if name == "start":
+            results.update(values)
+        elif name == "sim":
+            results["sim"] = values
+        elif name != "end":
+            results["benchmarks"][name] = values
+    return results
+
+
+def compare(results, baseline):
+    """Annotates each numeric metric with its baseline value and the percentage change."""
+    for name, metrics in results["benchmarks"].items():
+        previous = baseline.get("benchmarks", {}).get(name, {})
+        for key, value in list(metrics.items()):
+            old = previous.get(key)
+            if isinstance(old, dict):
+                old = old.get("value")
+            if not isinstance(value, int) or not isinstance(old, int):
+                continue
+            metrics[key] = {
+                "value": value,
+                "baseline": old,
+                "delta_pct": round((value - old) * 100.0 / old, 2) if old else None,
+            }
+    return results
+
+
+def run(sim, firmware, max_cycles):
+    command = [sim, firmware]
+    if max_cycles:
+        command.append(str(max_cycles))
+    proc = subprocess.run(command, stdout=subprocess.PIPE, universal_newlines=True)
+    results = parse(proc.stdout.splitlines())
+    results["firmware"] = os.path.basename(firmware)
+    results["completed"] = proc.returncode == 0
+    return results
+
+
+def selftest():
+    output = [
+        "@start f_cpu=16000000",
+        "@pin_toggle toggles_per_s=400000 cycles_per_toggle=40",
+        "UUUU",
+        "@i2c_100 write_us=1700 read_us=2100 read_bytes_per_s=7600 errors=0",
+        "@end",
+        "@sim cycles=123456 uart_bytes=1400 i2c_transactions=19 completed=1",
+    ]
+    results = parse(output)
+    assert results["f_cpu"] == 16000000
+    assert results["sim"]["cycles"] == 123456
+    assert results["benchmarks"]["pin_toggle"]["toggles_per_s"] == 400000
+    assert results["benchmarks"]["i2c_100"]["errors"] == 0
+    assert len(results["benchmarks"]) == 2
+
+    baseline = json.loads(json.dumps(results))
+    results = parse(output)
+    results["benchmarks"]["pin_toggle"]["toggles_per_s"] = 500000
+    compare(results, baseline)
+    metric = results["benchmarks"]["pin_toggle"]["toggles_per_s"]
+    assert metric == {"value": 500000, "baseline": 400000, "delta_pct": 25.0}, metric
+
+    # Comparing against a previous comparison uses its values.
+    again = compare(parse(output), results)
+    assert again["benchmarks"]["pin_toggle"]["toggles_per_s"]["baseline"] == 500000
+
+    print("selftest passed")
+    return 0
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("firmware", nargs="?", help="benchmark firmware ELF")
+    parser.add_argument("--sim", default=DEFAULT_SIM, help="simavr host binary (default: %(default)s)")
+    parser.add_argument("--max-cycles", type=int, default=0, help="simulation cycle limit")
+    parser.add_argument("--compare", metavar="JSON", help="earlier results to compare against")
+    parser.add_argument("--output", "-o", help="write the JSON here rather than to stdout")
+    parser.add_argument("--selftest", action="store_true", help="check the result parser and exit")
+    args = parser.parse_args()
+
+    if args.selftest:
+        return selftest()
+
+    if not args.firmware:
+        parser.error("a firmware ELF is required")
+
+    results = run(args.sim, args.firmware, args.max_cycles)
+
+    if args.compare:
+        with open(args.compare) as f:
+            compare(results, json.load(f))
+
+    text = json.dumps(results, indent=2, sort_keys=True)
+    if args.output:
+        with open(args.output, "w") as f:
+            f.write(text + "\n")
+    else:
+        print(text)
+
+    return 0 if results["completed"] else 1
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -0,0 +1,221 @@
+/*
+The MIT License (MIT)
+
+Copyright (c) 2017 Lancaster University.
+
+Permission is hereby granted, free of charge, to any person obtaining a
+copy of this software and associated documentation files (the "Software"),
+to deal in the Software without restriction, including without limitation
+the rights to use, copy, modify, merge, publish, distribute, sublicense,
+and/or sell copies of the Software, and to permit persons to whom the
+Software is furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+DEALINGS IN THE SOFTWARE.
+*/
+
+/*
+ * simavr host for the benchmark firmware in ../firmware.
+ *
+ * Runs the firmware on a simulated ATMega328p with:
+ *   - a UART sink on USART0, which echoes each "@..." result line to stdout and counts every byte received;
+ *   - a 256 byte 24C02 style I2C EEPROM / sensor register map at address 0xA0 (8 bit);
+ *   - a fixed voltage on ADC0.
+ *
+ * Usage: bench_sim <firmware.elf> [max_cycles]
+ *
+ * Exits 0 once the firmware halts after reporting "@end", or 1 if it crashes or runs out of cycles.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <simavr/sim_avr.h>
+#include <simavr/sim_elf.h>
+#include <simavr/sim_irq.h>
+#include <simavr/avr_uart.h>
+#include <simavr/avr_twi.h>
+#include <simavr/avr_adc.h>
+
+#define BENCH_F_CPU             16000000
+#define BENCH_MAX_CYCLES        (BENCH_F_CPU * 10ULL)
+#define BENCH_ADC0_MV           2500
+#define BENCH_VCC_MV            5000
+
+#define EEPROM_ADDRESS          0xA0
+#define EEPROM_SIZE             256
+
+/* UART sink. */
+typedef struct
+{
+    char        line[256];
+    int         length;
+    unsigned    received;
+    int         done;
+} uart_sink_t;
+
+/* I2C EEPROM / register map. */
+typedef struct
+{
+    avr_irq_t   *irq;
+    uint8_t     selected;
+    uint8_t     pointer_set;
+    uint8_t     pointer;
+    uint8_t     data[EEPROM_SIZE];
+    unsigned    transactions;
+} i2c_eeprom_t;
+
+static void uart_output_hook(struct avr_irq_t *irq, uint32_t value, void *param)
+{
+    uart_sink_t *sink = (uart_sink_t *)param;
+    char c = (char)value;
+
+    (void)irq;
+    sink->received++;
+
+    if (c == '\n')
+    {
+        sink->line[sink->length] = 0;
+
+        if (sink->line[0] == '@')
+        {
+            printf("%s\n", sink->line);
+            fflush(stdout);
+
+            if (strcmp(sink->line, "@end") == 0)
+                sink->done = 1;
+        }
+
+        sink->length = 0;
+    }
+    else if (sink->length < (int)sizeof(sink->line) - 1)
+    {
+        sink->line[sink->length++] = c;
+    }
+}
+
+static void i2c_eeprom_hook(struct avr_irq_t *irq, uint32_t value, void *param)
+{
+    i2c_eeprom_t *p = (i2c_eeprom_t *)param;
+    avr_twi_msg_irq_t v;
+
+    (void)irq;
+    v.u.v = value;
+
+    if (v.u.twi.msg & TWI_COND_STOP)
+        p->selected = 0;
+
+    if (v.u.twi.msg & TWI_COND_START)
+    {
+        p->selected = 0;
+
+        if ((v.u.twi.addr & ~1) == EEPROM_ADDRESS)
+        {
+            p->selected = v.u.twi.addr;
+            p->transactions++;
+
+            /* A write transaction begins by setting the register pointer. */
+            p->pointer_set = 0;
+            avr_raise_irq(p->irq + TWI_IRQ_INPUT, avr_twi_irq_msg(TWI_COND_ACK, p->selected, 1));
+        }
+    }
+
+    if (!p->selected)
+        return;
+
+    if (v.u.twi.msg & TWI_COND_WRITE)
+    {
+        avr_raise_irq(p->irq + TWI_IRQ_INPUT, avr_twi_irq_msg(TWI_COND_ACK, p->selected, 1));
+
+        if (!p->pointer_set)
+        {
+            p->pointer = v.u.twi.data;
+            p->pointer_set = 1;
+        }
+        else
+        {
+            p->data[p->pointer++] = v.u.twi.data;
+        }
+    }
+
+    if (v.u.twi.msg & TWI_COND_READ)
+        avr_raise_irq(p->irq + TWI_IRQ_INPUT, avr_twi_irq_msg(TWI_COND_READ, p->selected, p->data[p->pointer++]));
+}
+
+static void i2c_eeprom_attach(avr_t *avr, i2c_eeprom_t *p)
+{
+    static const char *names[2] = { "8>eeprom.out", "32<eeprom.in" };
+
+    memset(p, 0, sizeof(*p));
+    p->irq = avr_alloc_irq(&avr->irq_pool, 0, 2, names);
+    avr_irq_register_notify(p->irq + TWI_IRQ_OUTPUT, i2c_eeprom_hook, p);
+
+    avr_connect_irq(p->irq + TWI_IRQ_INPUT, avr_io_getirq(avr, AVR_IOCTL_TWI_GETIRQ(0), TWI_IRQ_INPUT));
+    avr_connect_irq(avr_io_getirq(avr, AVR_IOCTL_TWI_GETIRQ(0), TWI_IRQ_OUTPUT), p->irq + TWI_IRQ_OUTPUT);
+}
+
+int main(int argc, char **argv)
+{
+    elf_firmware_t firmware;
+    uart_sink_t sink;
+    i2c_eeprom_t eeprom;
+    uint32_t flags = 0;
+
+    if (argc < 2)
+    {
+        fprintf(stderr, "usage: %s <firmware.elf> [max_cycles]\n", argv[0]);
+        return 2;
+    }
+
+    unsigned long long maxCycles = argc > 2 ? strtoull(argv[2], NULL, 0) : BENCH_MAX_CYCLES;
+
+    memset(&firmware, 0, sizeof(firmware));
+    if (elf_read_firmware(argv[1], &firmware) != 0)
+    {
+        fprintf(stderr, "unable to load %s\n", argv[1]);
+        return 2;
+    }
+
+    avr_t *avr = avr_make_mcu_by_name("atmega328p");
+    if (!avr)
+    {
+        fprintf(stderr, "atmega328p not supported by this simavr\n");
+        return 2;
+    }
+
+    avr_init(avr);
+    avr_load_firmware(avr, &firmware);
+    avr->frequency = BENCH_F_CPU;
+    avr->avcc = BENCH_VCC_MV;
+    avr->aref = BENCH_VCC_MV;
+    avr->vcc = BENCH_VCC_MV;
+
+    /* Capture the UART ourselves, rather than have simavr echo it. */
+    memset(&sink, 0, sizeof(sink));
+    avr_ioctl(avr, AVR_IOCTL_UART_GET_FLAGS('0'), &flags);
+    flags &= ~AVR_UART_FLAG_STDIO;
+    avr_ioctl(avr, AVR_IOCTL_UART_SET_FLAGS('0'), &flags);
+    avr_irq_register_notify(avr_io_getirq(avr, AVR_IOCTL_UART_GETIRQ('0'), UART_IRQ_OUTPUT), uart_output_hook, &sink);
+
+    i2c_eeprom_attach(avr, &eeprom);
+
+    avr_raise_irq(avr_io_getirq(avr, AVR_IOCTL_ADC_GETIRQ, ADC_IRQ_ADC0), BENCH_ADC0_MV);
+
+    int state = cpu_Running;
+    while (state != cpu_Done && state != cpu_Crashed && avr->cycle < maxCycles)
+        state = avr_run(avr);
+
+    printf("@sim cycles=%llu uart_bytes=%u i2c_transactions=%u completed=%d\n",
+           (unsigned long long)avr->cycle, sink.received, eeprom.transactions, sink.done);
+
+    return sink.done && state != cpu_Crashed ? 0 : 1;
+}
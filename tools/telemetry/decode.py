@@ -0,0 +1,205 @@
+#!/usr/bin/env python3
+"""
+Host side decoder for the ATMegaTelemetry binary protocol.
+
+Frames are COBS encoded and delimited by zero bytes. Once decoded, each frame holds a record
+type byte, a payload of little endian fields, and a CRC-16/CCITT (polynomial 0x1021, initial
+value 0xFFFF) over both, stored little endian.
+
+Usage:
+    decode.py /dev/ttyUSB0 --baud 115200 --format 1:HHh --format 2:If
+    decode.py --selftest
+
+Payload layouts are given as python struct format characters per record type. Records of
+unknown type are printed as hex.
+"""
+
+import argparse
+import os
+import struct
+import sys
+
+
+def crc16(data, crc=0xFFFF):
+    for b in data:
+        crc ^= b << 8
+        for _ in range(8):
+            crc = ((crc << 1) ^ 0x1021) if crc & 0x8000 else (crc << 1)
+            crc &= 0xFFFF
+    return crc
+
+
+def cobs_encode(data):
+    out = bytearray()
+    start = 0
+    while True:
+        end = start
+        while end < len(data) and data[end] != 0 and end - start < 254:
+            end += 1
+        out.append(end - start + 1)
+        out += data[start:end]
+        if end == len(data):
+            break
+        start = end + 1 if data[end] == 0 else end
+    return bytes(out)
+
+
+def cobs_decode(data):
+    out = bytearray()
+    i = 0
+    while i < len(data):
+        code = data[i]
+        if code == 0 or i + code > len(data):
+            raise ValueError("truncated COBS block")
+        out += data[i + 1:i + code]
+        i += code
+        if code < 0xFF and i < len(data):
+            out.append(0)
+    return bytes(out)
+
+
+def encode_record(record_type, payload):
+    frame = bytes([record_type]) + payload
+    frame += struct.pack("<H", crc16(frame))
+    return cobs_encode(frame) + b"\x00"
+
+
+class Decoder:
+    """
+    Incremental decoder. Feed it bytes as they arrive; it yields (type, payload) for every
+    valid frame, and counts frames discarded by COBS or CRC errors.
+    """
+
+    def __init__(self):
+        self.pending = bytearray()
+        self.errors = 0
+
+    def feed(self, data):
+        self.pending += data
+        while True:
+            try:
+                end = self.pending.index(0)
+            except ValueError:
+                return
+            encoded = bytes(self.pending[:end])
+            del self.pending[:end + 1]
+            if not encoded:
+                continue
+            try:
+                frame = cobs_decode(encoded)
+            except ValueError:
+                self.errors += 1
+                continue
+            if len(frame) < 3 or crc16(frame[:-2]) != struct.unpack("<H", frame[-2:])[0]:
+                self.errors += 1
+                continue
+            yield frame[0], frame[1:-2]
+
+
+def parse_formats(specs):
+    formats = {}
+    for spec in specs or []:
+        record_type, layout = spec.split(":", 1)
+        formats[int(record_type, 0)] = "<" + layout
+    return formats
+
+
+def describe(record_type, payload, formats):
+    layout = formats.get(record_type)
+    if layout and struct.calcsize(layout) == len(payload):
+        fields = struct.unpack(layout, payload)
+        return "%d: %s" % (record_type, " ".join(str(f) for f in fields))
+    return "%d: %s" % (record_type, payload.hex())
+
+
+def selftest():
+    """
+    Round trips frames through a pseudo terminal pair, with corruption injected between them,
+    to check encoding, decoding and resynchronisation.
+    """
+    import tty
+
+    master, slave = os.openpty()
+    tty.setraw(slave)
+
+    records = [
+        (1, struct.pack("<HHh", 512, 0, -3)),
+        (2, b""),
+        (3, bytes(range(256))[:40]),
+        (4, b"\x00" * 5),
+        (5, bytes([0x11] * 300)),
+    ]
+
+    stream = bytearray()
+    for record_type, payload in records:
+        stream += encode_record(record_type, payload)
+        # A damaged frame (bad CRC), then line noise that happens to end in a zero.
+        damaged = bytearray(encode_record(9, b"\x01\x02\x03"))
+        damaged[2] ^= 0xFF
+        stream += damaged + b"\x07\xff\x07\x00"
+
+    os.write(master, bytes(stream))
+
+    decoder = Decoder()
+    received = []
+    total = 0
+    while total < len(stream):
+        data = os.read(slave, 64)
+        total += len(data)
+        received += list(decoder.feed(data))
+
+    os.close(master)
+    os.close(slave)
+
+    if received != records:
+        print("FAIL: decoded %r" % received)
+        return 1
+    if decoder.errors != 2 * len(records):
+        print("FAIL: expected %d damaged frames, saw %d" % (2 * len(records), decoder.errors))
+        return 1
+    if crc16(b"123456789") != 0x29B1:
+        print("FAIL: CRC check value")
+        return 1
+
+    print("OK: %d records decoded, %d damaged frames discarded" % (len(received), decoder.errors))
+    return 0
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("port", nargs="?", help="serial device or file to read ('-' for stdin)")
+    parser.add_argument("--baud", type=int, default=115200)
+    parser.add_argument("--format", action="append", help="TYPE:STRUCT payload layout, e.g. 1:HHh")
+    parser.add_argument("--selftest", action="store_true", help="run a loopback test over a PTY")
+    args = parser.parse_args()
+
+    if args.selftest:
+        return selftest()
+
+    if not args.port:
+        parser.error("a port is required")
+
+    formats = parse_formats(args.format)
+    decoder = Decoder()
+
+    if args.port == "-":
+        source = sys.stdin.buffer
+    elif args.port.startswith("/dev/"):
+        import serial
+        source = serial.Serial(args.port, args.baud)
+    else:
+        source = open(args.port, "rb")
+
+    while True:
+        data = source.read(1)
+        if not data:
+            break
+        for record_type, payload in decoder.feed(data):
+            print(describe(record_type, payload, formats))
+
+    print("%d damaged frames discarded" % decoder.errors, file=sys.stderr)
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
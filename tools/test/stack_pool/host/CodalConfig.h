@@ -0,0 +1,8 @@
+// Host stand-in for the target configuration, enough to build the stack pool.
+#ifndef CODAL_CONFIG_H
+#define CODAL_CONFIG_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+#endif
@@ -0,0 +1,8 @@
+// The host tests are single threaded, so interrupts need not be masked.
+#ifndef HOST_AVR_INTERRUPT_H
+#define HOST_AVR_INTERRUPT_H
+
+#define cli()
+#define sei()
+
+#endif
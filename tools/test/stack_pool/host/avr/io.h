@@ -0,0 +1,9 @@
+// Host stand-in for the status register the stack pool saves around its critical sections.
+#ifndef HOST_AVR_IO_H
+#define HOST_AVR_IO_H
+
+#include <stdint.h>
+
+extern volatile uint8_t SREG;
+
+#endif
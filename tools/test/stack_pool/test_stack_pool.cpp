@@ -0,0 +1,194 @@
+/*
+The MIT License (MIT)
+
+Copyright (c) 2017 Lancaster University.
+
+Permission is hereby granted, free of charge, to any person obtaining a
+copy of this software and associated documentation files (the "Software"),
+to deal in the Software without restriction, including without limitation
+the rights to use, copy, modify, merge, publish, distribute, sublicense,
+and/or sell copies of the Software, and to permit persons to whom the
+Software is furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+DEALINGS IN THE SOFTWARE.
+*/
+
+/**
+  * Host tests for the stack pool. Each test starts from an empty pool and must return it empty.
+  */
+
+#include "ATMegaStackPool.h"
+#include <stdio.h>
+#include <string.h>
+
+volatile uint8_t SREG;
+
+#define BLOCK(c)        ((uint16_t)1 << (ATMEGA_STACK_POOL_MIN_SHIFT + (c)))
+
+static int failed = 0;
+
+#define CHECK(condition)                                                            \
+    do {                                                                            \
+        if (!(condition)) {                                                         \
+            printf("  %s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, #condition);  \
+            failed++;                                                               \
+        }                                                                           \
+    } while (0)
+
+static StackPoolStats stats()
+{
+    StackPoolStats s;
+    stack_pool_get_stats(&s);
+    return s;
+}
+
+static void check_empty()
+{
+    StackPoolStats s = stats();
+
+    CHECK(s.arenaUsed == 0);
+    CHECK(s.largestFree == ATMEGA_STACK_POOL_MAX_BLOCK);
+    CHECK(s.free[ATMEGA_STACK_POOL_CLASSES - 1] == ATMEGA_STACK_POOL_SIZE / ATMEGA_STACK_POOL_MAX_BLOCK);
+
+    for (int c = 0; c < ATMEGA_STACK_POOL_CLASSES - 1; c++)
+        CHECK(s.free[c] == 0);
+}
+
+/**
+  * A fiber's stack grows one class at a time up to half the largest block, then shrinks back to the
+  * smallest. Nothing may be left behind: the memory it used must serve another fiber's large stack.
+  */
+static void test_grow_then_shrink()
+{
+    void *stack = NULL;
+    uint16_t capacity = 0;
+
+    for (int c = 0; c < ATMEGA_STACK_POOL_CLASSES - 1; c++)
+    {
+        stack = stack_pool_resize(stack, BLOCK(c) - 1, &capacity);
+        CHECK(stack != NULL);
+        CHECK(capacity == BLOCK(c) - 1);
+
+        // Only the current block is in use, whatever the classes it passed through.
+        CHECK(stats().arenaUsed == BLOCK(c));
+        memset(stack, 0xA5, capacity);
+    }
+
+    // A shallow stack shrinks to the class that leaves it room to double.
+    stack = stack_pool_resize(stack, BLOCK(0) / 2 - 1, &capacity);
+    CHECK(capacity == BLOCK(0) - 1);
+    CHECK(stats().arenaUsed == BLOCK(0));
+
+    // The released halves have merged: every top level block but the one holding the small stack is whole.
+    StackPoolStats s = stats();
+    CHECK(s.free[ATMEGA_STACK_POOL_CLASSES - 1] == ATMEGA_STACK_POOL_SIZE / ATMEGA_STACK_POOL_MAX_BLOCK - 1);
+    for (int c = 0; c < ATMEGA_STACK_POOL_CLASSES - 1; c++)
+        CHECK(s.free[c] == 1);
+
+    // So another fiber can now take a stack of the size the first one reached, and one of the largest size.
+    void *other = stack_pool_alloc(BLOCK(ATMEGA_STACK_POOL_CLASSES - 2) - 1);
+    void *largest = stack_pool_alloc(ATMEGA_STACK_POOL_MAX_BUFFER);
+    CHECK(other != NULL);
+    CHECK(largest != NULL);
+    CHECK(stats().failures == 0);
+
+    stack_pool_free(stack);
+    stack_pool_free(other);
+    stack_pool_free(largest);
+    check_empty();
+}
+
+/**
+  * A stack that needs no resize keeps its buffer.
+  */
+static void test_resize_hysteresis()
+{
+    uint16_t capacity;
+    void *stack = stack_pool_resize(NULL, BLOCK(2) - 1, &capacity);
+
+    CHECK(stack_pool_resize(stack, BLOCK(2) - 1, &capacity) == stack);
+    CHECK(stack_pool_resize(stack, BLOCK(0), &capacity) == stack);
+    CHECK(capacity == BLOCK(2) - 1);
+
+    stack_pool_free(stack);
+    check_empty();
+}
+
+/**
+  * Buffers freed out of order, with live neighbours, still coalesce once their buddies are released.
+  */
+static void test_coalesce_out_of_order()
+{
+    void *small[BLOCK(ATMEGA_STACK_POOL_CLASSES - 1) / BLOCK(0)];
+    int count = sizeof(small) / sizeof(small[0]);
+
+    for (int i = 0; i < count; i++)
+    {
+        small[i] = stack_pool_alloc(1);
+        CHECK(small[i] != NULL);
+    }
+
+    // Free the odd blocks, then the even ones, so no merge is possible until the second pass.
+    for (int i = 1; i < count; i += 2)
+        stack_pool_free(small[i]);
+
+    CHECK(stats().free[0] == count / 2);
+
+    for (int i = 0; i < count; i += 2)
+        stack_pool_free(small[i]);
+
+    check_empty();
+}
+
+/**
+  * Exhausting the pool fails cleanly, and a failed grow releases the old buffer.
+  */
+static void test_exhaustion()
+{
+    void *blocks[ATMEGA_STACK_POOL_SIZE / ATMEGA_STACK_POOL_MAX_BLOCK];
+    int count = sizeof(blocks) / sizeof(blocks[0]);
+    uint16_t failures = stats().failures;
+
+    for (int i = 0; i < count; i++)
+        blocks[i] = stack_pool_alloc(ATMEGA_STACK_POOL_MAX_BUFFER);
+
+    CHECK(stack_pool_alloc(1) == NULL);
+    CHECK(stack_pool_alloc(ATMEGA_STACK_POOL_MAX_BUFFER + 1) == NULL);
+    CHECK(stats().failures == failures + 2);
+
+    for (int i = 1; i < count; i++)
+        stack_pool_free(blocks[i]);
+
+    CHECK(stack_pool_grow(blocks[0], ATMEGA_STACK_POOL_MAX_BUFFER + 1) == NULL);
+    check_empty();
+}
+
+int main()
+{
+    static const struct { const char *name; void (*run)(); } tests[] = {
+        { "grow_then_shrink", test_grow_then_shrink },
+        { "resize_hysteresis", test_resize_hysteresis },
+        { "coalesce_out_of_order", test_coalesce_out_of_order },
+        { "exhaustion", test_exhaustion },
+    };
+
+    check_empty();
+
+    for (unsigned i = 0; i < sizeof(tests) / sizeof(tests[0]); i++)
+    {
+        int before = failed;
+        tests[i].run();
+        printf("%s %s\n", failed == before ? "PASS" : "FAIL", tests[i].name);
+    }
+
+    return failed ? 1 : 0;
+}